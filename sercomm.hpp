@@ -0,0 +1,100 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * C++ template over the size type variants
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM_HPP
+#define _SERCOMM_HPP
+
+extern "C" {
+#include "sercomm.h"
+#include "sercomm8.h"
+#include "sercomm16.h"
+}
+
+namespace sc {
+
+/*!
+ * \brief Size type variant of the parser and the generator
+ *
+ * It maps a size type (uint8_t, uint16_t or uint32_t) to the struct sercomm variant and its
+ * functions, so a C++ code could be written once over the size type. See sercomm8.h.
+ *
+ * Example:
+ * \code
+ * typedef sc::fit<64>::type small_t;           // uint8_t
+ * static sc::variant<small_t>::sercomm * ch;
+ *
+ * sc::variant<small_t>::get_message(ch, sms, byte);
+ * \endcode
+ */
+template <typename Size> struct variant;
+
+#define SC_HPP_VARIANT(size_type, suffix) \
+template <> struct variant<size_type> { \
+    typedef struct sercomm##suffix sercomm; \
+    typedef struct sercomm_msg##suffix msg; \
+    typedef struct sercomm_frame##suffix frame; \
+    typedef size_type size; \
+    static size make_message(sercomm * sc, size cmd, size cctrl, unsigned char * m, size mlen, \
+            unsigned char * output, size olen) \
+    { return sc_make_message##suffix(sc, cmd, cctrl, m, mlen, output, olen); } \
+    static size make_message_ts(sercomm * sc, size cmd, size cctrl, uint32_t ts, unsigned char * m, \
+            size mlen, unsigned char * output, size olen) \
+    { return sc_make_message_ts##suffix(sc, cmd, cctrl, ts, m, mlen, output, olen); } \
+    static void get_message(sercomm * sc, msg * sm, unsigned char byte) \
+    { sc_get_message##suffix(sc, sm, byte); } \
+    static int dispatch(msg * sm, frame * f, void * priv) \
+    { return sc_dispatch##suffix(sm, f, priv); } \
+    static uint32_t frame_ts(sercomm * sc, frame * f) \
+    { return sc_frame_ts##suffix(sc, f); } \
+}
+
+SC_HPP_VARIANT(uint8_t, 8);
+SC_HPP_VARIANT(uint16_t, 16);
+#ifndef SERCOMM_USE_TINY_SC
+SC_HPP_VARIANT(uint32_t, );
+#endif
+
+#undef SC_HPP_VARIANT
+
+/*! \brief Internal usage: The size type selection of fit */
+template <bool Small, bool Medium> struct fit_size { typedef uint32_t type; };
+template <bool Medium> struct fit_size<true, Medium> { typedef uint8_t type; };
+template <> struct fit_size<false, true> { typedef uint16_t type; };
+
+/*!
+ * \brief The smallest size type for a maximal length
+ *
+ * The maximal value of the type is reserved (SERCOMM_IGNORE_MSG_VALID_LENGTH).
+ *
+ * \param MaxLen The maximal length of a message with the header (or the buffer size)
+ */
+template <uint32_t MaxLen> struct fit {
+    typedef typename fit_size<(MaxLen < UINT8_MAX), (MaxLen < UINT16_MAX)>::type type;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,76 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * 16-bit size type variant
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM16_H
+#define _SERCOMM16_H
+
+#include "sercomm.h"
+
+/*!
+ * \brief 16-bit size type variant
+ *
+ * It is the parser and the generator of sercomm.h with uint16_t lengths, command and comm. controll
+ * values: struct sercomm16, struct sercomm_msg16, struct sercomm_frame16,
+ * sc_make_message16(), sc_make_message_ts16(), sc_get_message16(), sc_dispatch16()
+ * and sc_frame_ts16(). The variants could be used together in one binary, i.e., a smaller
+ * struct sercomm16 for the channels with short messages beside a struct sercomm for the bulk
+ * channel. The usage is the same as of the default variant.
+ *
+ * The buffer size and the message length should fit in uint16_t, and the Command and
+ * Comm. controll fields should not be longer than 2 bytes.
+ * The modules (i.e., sercomm_vc.h) work with the default variant.
+ *
+ * Example:
+ * \code
+ * static union {
+ *     struct sercomm16 sc;
+ *     unsigned char raw[SIZEOF_SC16(2)];
+ * } small[1000];
+ *
+ * sc_get_message16(&small[ch].sc, sms16, byte);
+ * \endcode
+ */
+typedef uint16_t								sc_size16_t;
+typedef uint16_t								sc_cmd16_t;
+typedef uint16_t								sc_cctrl16_t;
+/*! \brief Ignore message validity check. Use in message_max_len in struct sercomm16 */
+#define SERCOMM16_IGNORE_MSG_VALID_LENGTH	UINT16_MAX
+
+#define SC_T_NAME(name)						name##16
+#define SC_T_SIZE							sc_size16_t
+#define SC_T_CMD							sc_cmd16_t
+#define SC_T_CCTRL							sc_cctrl16_t
+#include "sercomm_tmpl.h"
+
+/*!
+ * \brief The size of the struct sercomm16 with the dynamic frame_start part
+ *
+ * \param frame_start_length The length of the frame_start array
+ */
+#define SIZEOF_SC16(frame_start_length) \
+    ( offsetof(struct sercomm16, frame_start) + (frame_start_length) * sizeof ((struct sercomm16 *)0)->frame_start[0] )
+
+#endif
+
@@ -0,0 +1,41 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * 8-bit size type variant
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <string.h>
+
+#include "sercomm.h"
+#include "sercomm_filter.h"
+#include "sercomm_fec.h"
+#include "sercomm_crc.h"
+#include "sercomm_stats.h"
+#include "sercomm8.h"
+
+#define SC_T_NAME(name)						name##8
+#define SC_T_SIZE							sc_size8_t
+#define SC_T_CMD							sc_cmd8_t
+#define SC_T_CCTRL							sc_cctrl8_t
+#define SC_T_IGNORE							SERCOMM8_IGNORE_MSG_VALID_LENGTH
+#include "sercomm_tmpl_impl.h"
+
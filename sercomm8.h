@@ -0,0 +1,76 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * 8-bit size type variant
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM8_H
+#define _SERCOMM8_H
+
+#include "sercomm.h"
+
+/*!
+ * \brief 8-bit size type variant
+ *
+ * It is the parser and the generator of sercomm.h with uint8_t lengths, command and comm. controll
+ * values: struct sercomm8, struct sercomm_msg8, struct sercomm_frame8,
+ * sc_make_message8(), sc_make_message_ts8(), sc_get_message8(), sc_dispatch8()
+ * and sc_frame_ts8(). The variants could be used together in one binary, i.e., a smaller
+ * struct sercomm8 for the channels with short messages beside a struct sercomm for the bulk
+ * channel. The usage is the same as of the default variant.
+ *
+ * The buffer size and the message length should fit in uint8_t, and the Command and
+ * Comm. controll fields should not be longer than 1 byte.
+ * The modules (i.e., sercomm_vc.h) work with the default variant.
+ *
+ * Example:
+ * \code
+ * static union {
+ *     struct sercomm8 sc;
+ *     unsigned char raw[SIZEOF_SC8(2)];
+ * } small[1000];
+ *
+ * sc_get_message8(&small[ch].sc, sms8, byte);
+ * \endcode
+ */
+typedef uint8_t								sc_size8_t;
+typedef uint8_t								sc_cmd8_t;
+typedef uint8_t								sc_cctrl8_t;
+/*! \brief Ignore message validity check. Use in message_max_len in struct sercomm8 */
+#define SERCOMM8_IGNORE_MSG_VALID_LENGTH	UINT8_MAX
+
+#define SC_T_NAME(name)						name##8
+#define SC_T_SIZE							sc_size8_t
+#define SC_T_CMD							sc_cmd8_t
+#define SC_T_CCTRL							sc_cctrl8_t
+#include "sercomm_tmpl.h"
+
+/*!
+ * \brief The size of the struct sercomm8 with the dynamic frame_start part
+ *
+ * \param frame_start_length The length of the frame_start array
+ */
+#define SIZEOF_SC8(frame_start_length) \
+    ( offsetof(struct sercomm8, frame_start) + (frame_start_length) * sizeof ((struct sercomm8 *)0)->frame_start[0] )
+
+#endif
+
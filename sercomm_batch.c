@@ -0,0 +1,126 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Batched delivery
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <string.h>
+
+#include "sercomm_batch.h"
+
+void sc_batch_init(struct sc_batch * batch, struct sercomm * sc)
+{
+    uint8_t i;
+
+    batch->sc = sc;
+    for (i = 0; i < batch->ngroups; i++) {
+        batch->groups[i].count = 0;
+        batch->groups[i].used = 0;
+    }
+    sc->frame = sc_batch_frame;
+    sc->priv = batch;
+}
+
+static void batch_deliver(struct sc_batch * batch, struct sc_batch_group * g)
+{
+    if (g->count == 0)
+        return;
+    g->fn(g->items, g->count, batch->priv);
+    g->batches++;
+    g->messages += g->count;
+    g->count = 0;
+    g->used = 0;
+}
+
+void sc_batch_poll(struct sc_batch * batch, uint32_t now)
+{
+    struct sc_batch_group * g;
+    uint8_t i;
+
+    batch->now = now;
+    for (i = 0; i < batch->ngroups; i++) {
+        g = &batch->groups[i];
+        if (g->count > 0 && g->max_age > 0 && now - g->start >= g->max_age)
+            batch_deliver(batch, g);
+    }
+}
+
+void sc_batch_flush(struct sc_batch * batch)
+{
+    uint8_t i;
+
+    for (i = 0; i < batch->ngroups; i++)
+        batch_deliver(batch, &batch->groups[i]);
+}
+
+void sc_batch_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_batch * batch = sc->priv;
+    struct sc_batch_group * g;
+    struct sc_batch_item * it;
+    struct sc_batch_item single;
+    uint8_t i;
+
+    (void)sm;
+    for (i = 0; i < batch->ngroups; i++) {
+        g = &batch->groups[i];
+        if (f->cmd >= g->cmd_first && f->cmd <= g->cmd_last)
+            break;
+    }
+    if (i == batch->ngroups) {
+        sc_dispatch(batch->sm, f, batch->priv);
+        return;
+    }
+
+    //Full by count or by bytes: deliver the pending batch first
+    if (g->count == g->nitems || g->pool_size - g->used < f->mlen)
+        batch_deliver(batch, g);
+
+    if (f->mlen > g->pool_size) {
+        //Too long for the body storage: deliver it alone from the parser buffer
+        single.ts = sc_frame_ts(sc, f);
+        single.cmd = f->cmd;
+        single.mlen = f->mlen;
+        single.msg = f->msg;
+        single.cctrl = f->cctrl;
+        g->fn(&single, 1, batch->priv);
+        g->batches++;
+        g->messages++;
+        return;
+    }
+
+    if (g->count == 0)
+        g->start = batch->now;
+    it = &g->items[g->count++];
+    it->ts = sc_frame_ts(sc, f);
+    it->cmd = f->cmd;
+    it->mlen = f->mlen;
+    it->msg = &g->pool[g->used];
+    it->cctrl = f->cctrl;
+    if (f->mlen > 0)
+        memcpy(it->msg, f->msg, f->mlen);
+    g->used += f->mlen;
+
+    if (g->count == g->nitems || g->used == g->pool_size)
+        batch_deliver(batch, g);
+}
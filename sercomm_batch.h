@@ -0,0 +1,157 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Batched delivery
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_BATCH_H
+#define _SERCOMM_BATCH_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief Batched message descriptor */
+struct sc_batch_item {
+	/*! The value of the Timestamp field */
+	uint32_t		ts;
+	/*! Message command value */
+	sc_cmd_t		cmd;
+	/*! The length of the message body */
+	sc_size_t		mlen;
+	/*! The message body. It is valid until the batch callback returns */
+	unsigned char * msg;
+	/*! The value of the comm. control field */
+	sc_cctrl_t		cctrl;
+};
+
+/*! \brief Batch of a command group */
+struct sc_batch_group {
+	/*! The first command of the group */
+	sc_cmd_t		cmd_first;
+	/*! The last command of the group */
+	sc_cmd_t		cmd_last;
+	/*! Batch callback: the messages in arrival order, and the priv field of struct sc_batch */
+	void			(* fn)(struct sc_batch_item * items, uint16_t n, void * priv);
+	/*! Descriptor storage. Its size is the count limit of the batch */
+	struct sc_batch_item * items;
+	/*! The number of the descriptors */
+	uint16_t		nitems;
+	/*! Body storage. Its size is the byte limit of the batch */
+	unsigned char * pool;
+	/*! The size of the body storage */
+	sc_size_t		pool_size;
+	/*! The deadline of a batch: the maximal age of its first message. Zero to omit */
+	uint32_t		max_age;
+	/*! Internal usage: The number of the batched messages */
+	uint16_t		count;
+	/*! Internal usage: The used bytes of the body storage */
+	sc_size_t		used;
+	/*! Internal usage: The arrival time of the first batched message */
+	uint32_t		start;
+	/*! Statistics: The number of the delivered batches */
+	uint32_t		batches;
+	/*! Statistics: The number of the delivered messages */
+	uint32_t		messages;
+};
+
+/*!
+ * \brief Batched delivery
+ *
+ * It collects the messages of command groups, and delivers them in batches, i.e., one
+ * database transaction per batch instead of one per message. A batch is delivered when its
+ * descriptor storage or its body storage is full, when its first message is older than the
+ * deadline, or by sc_batch_flush(). The bodies are copied to the body storage of the group,
+ * so they stay valid until the batch callback returns. A message, which is longer than the
+ * body storage, is delivered alone (after the pending batch), directly from the parser buffer.
+ *
+ * The messages of the other commands are processed by the command callbacks as usual.
+ * The time is given by sc_batch_poll(), which should be called periodically.
+ *
+ * Example:
+ * \code
+ * static struct sc_batch_item log_items[500];
+ * static unsigned char log_pool[64 * 1024];
+ * static struct sc_batch_group groups[] = {
+ *     { .cmd_first = MSG_COMMAND_LOG, .cmd_last = MSG_COMMAND_LOG_END, .fn = log_insert,
+ *       .items = log_items, .nitems = 500, .pool = log_pool, .pool_size = sizeof(log_pool),
+ *       .max_age = 200 },
+ * };
+ * static struct sc_batch batch = { .groups = groups, .ngroups = 1, .sm = sms };
+ *
+ * sc_batch_init(&batch, &sc);
+ * sc_get_message(&sc, sms, byte);
+ * sc_batch_poll(&batch, now_ms());         // periodically
+ * \endcode
+ */
+struct sc_batch {
+	/*! The parser */
+	struct sercomm * sc;
+	/*! The struct sercomm_msg array of the other commands */
+	struct sercomm_msg * sm;
+	/*! Last argument of the batch and command callbacks */
+	void *			priv;
+	/*! The command groups */
+	struct sc_batch_group * groups;
+	/*! The number of the command groups */
+	uint8_t			ngroups;
+	/*! Internal usage: The last time given to the library */
+	uint32_t		now;
+};
+
+/*!
+ * \brief Initialize the batched delivery
+ *
+ * It empties the batches, and sets the frame callback and the priv field of sc.
+ *
+ * \param batch The batched delivery
+ * \param sc The parser
+ */
+void sc_batch_init(struct sc_batch * batch, struct sercomm * sc);
+
+/*!
+ * \brief Deliver the batches, which are older than their deadline
+ *
+ * Call it periodically.
+ *
+ * \param batch The batched delivery
+ * \param now The current time
+ */
+void sc_batch_poll(struct sc_batch * batch, uint32_t now);
+
+/*!
+ * \brief Deliver all pending batches
+ *
+ * \param batch The batched delivery
+ */
+void sc_batch_flush(struct sc_batch * batch);
+
+/*!
+ * \brief Frame callback of the batched delivery
+ *
+ * sc_batch_init() sets it in the parser.
+ */
+void sc_batch_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+
@@ -0,0 +1,206 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Link bonding
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <string.h>
+
+#include "sercomm_bond.h"
+#include "sercomm_util.h"
+
+void sc_bond_init(struct sc_bond * bond)
+{
+    uint16_t i;
+
+    bond->tx_seq = 0;
+    bond->rx_seq = 0;
+    bond->head = 0;
+    bond->held = 0;
+    for (i = 0; i < bond->nslots; i++)
+        bond->slots[i].used = 0;
+    for (i = 0; i < bond->nports; i++) {
+        bond->ports[i].busy_until = 0;
+        bond->ports[i].sc->frame = sc_bond_frame;
+        bond->ports[i].sc->priv = bond;
+    }
+}
+
+int sc_bond_make_message(struct sc_bond * bond, uint32_t now, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        unsigned char * msg, sc_size_t mlen,
+        unsigned char * output, sc_size_t olen, sc_size_t * len)
+{
+    struct sc_bond_port * p;
+    uint32_t start, finish, best_finish = 0;
+    int i, best = -1;
+    sc_size_t n;
+
+    if (bond->nports == 0)
+        return -1;
+    n = sc_make_message_ts(bond->ports[0].sc, cmd, cctrl, bond->tx_seq, msg, mlen, output, olen);
+    if (n == 0)
+        return -1;
+
+    //The port which could finish the sending first
+    for (i = 0; i < bond->nports; i++) {
+        p = &bond->ports[i];
+        if (p->rate == 0)
+            continue;
+        if (p->backlog != NULL)
+            start = now + p->backlog(p) / p->rate;
+        else if ((int32_t)(p->busy_until - now) > 0)
+            start = p->busy_until;
+        else
+            start = now;
+        finish = start + (n + p->rate - 1) / p->rate;
+        if (best < 0 || (int32_t)(finish - best_finish) < 0) {
+            best = i;
+            best_finish = finish;
+        }
+    }
+    if (best < 0)
+        return -1;
+
+    p = &bond->ports[best];
+    p->busy_until = best_finish;
+    p->tx_messages++;
+    p->tx_bytes += n;
+    bond->tx_seq = (bond->tx_seq + 1) & sc_ts_mask(p->sc);
+    bond->now = now;
+    *len = n;
+    return best;
+}
+
+static unsigned char * slot_data(struct sc_bond * bond, uint16_t idx)
+{
+    return &bond->bodies[(uint32_t)idx * bond->slot_size];
+}
+
+/* Deliver or skip the message of rx_seq, and step to the next one */
+static void bond_advance(struct sc_bond * bond)
+{
+    struct sercomm * sc = bond->ports[0].sc;
+    struct sc_bond_slot * s = &bond->slots[bond->head];
+    struct sercomm_frame f;
+
+    if (s->used) {
+        f.ts = slot_data(bond, bond->head);
+        f.cmd = s->cmd;
+        f.mlen = s->mlen;
+        f.msg = f.ts + sc->ts_bytes;
+        f.cctrl = s->cctrl;
+        s->used = 0;
+        bond->held--;
+        bond->rx_messages++;
+        bond->rx_reordered++;
+        sc_dispatch(bond->sm, &f, bond->priv);
+    } else {
+        bond->rx_lost++;
+    }
+    bond->head = (bond->head + 1) % bond->nslots;
+    bond->rx_seq = (bond->rx_seq + 1) & sc_ts_mask(sc);
+}
+
+static void bond_drain(struct sc_bond * bond)
+{
+    while (bond->held > 0 && bond->slots[bond->head].used)
+        bond_advance(bond);
+}
+
+void sc_bond_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_bond * bond = sc->priv;
+    struct sc_bond_slot * s;
+    uint32_t mask = sc_ts_mask(sc), d;
+    uint16_t idx;
+
+    (void)sm;
+    d = (sc_frame_ts(sc, f) - bond->rx_seq) & mask;
+    if (d > mask / 2) {
+        //Older than the next expected: duplicated or skipped already
+        bond->rx_dropped++;
+        return;
+    }
+    //Far ahead: give up the oldest missing messages
+    while (d >= bond->nslots) {
+        bond_advance(bond);
+        bond_drain(bond);
+        d = (sc_frame_ts(sc, f) - bond->rx_seq) & mask;
+    }
+
+    if (d == 0) {
+        bond->head = (bond->head + 1) % bond->nslots;
+        bond->rx_seq = (bond->rx_seq + 1) & mask;
+        bond->rx_messages++;
+        sc_dispatch(bond->sm, f, bond->priv);
+        bond_drain(bond);
+        return;
+    }
+
+    idx = (bond->head + d) % bond->nslots;
+    s = &bond->slots[idx];
+    if (s->used || sc->ts_bytes + f->mlen > bond->slot_size) {
+        bond->rx_dropped++;
+        return;
+    }
+    s->used = 1;
+    s->cmd = f->cmd;
+    s->cctrl = f->cctrl;
+    s->mlen = f->mlen;
+    s->time = bond->now;
+    memcpy(slot_data(bond, idx), f->ts, sc->ts_bytes);
+    memcpy(slot_data(bond, idx) + sc->ts_bytes, f->msg, f->mlen);
+    bond->held++;
+}
+
+void sc_bond_feed(struct sc_bond * bond, uint8_t port, const unsigned char * data, sc_size_t len,
+        uint32_t now)
+{
+    sc_size_t i;
+
+    if (port >= bond->nports)
+        return;
+    //The arrival time of the held messages
+    bond->now = now;
+    for (i = 0; i < len; i++)
+        sc_get_message(bond->ports[port].sc, NULL, data[i]);
+}
+
+void sc_bond_poll(struct sc_bond * bond, uint32_t now)
+{
+    uint16_t i, idx = 0;
+
+    bond->now = now;
+    while (bond->held > 0) {
+        //The first held message after the gap
+        for (i = 0; i < bond->nslots; i++) {
+            idx = (bond->head + i) % bond->nslots;
+            if (bond->slots[idx].used)
+                break;
+        }
+        if (i == bond->nslots || now - bond->slots[idx].time < bond->timeout)
+            break;
+        while (i-- > 0)
+            bond_advance(bond);
+        bond_drain(bond);
+    }
+}
@@ -0,0 +1,198 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Link bonding
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM_BOND_H
+#define _SERCOMM_BOND_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief Physical port of a bonded link */
+struct sc_bond_port {
+	/*! The parser of the port. Each port needs its own struct sercomm and buffer */
+	struct sercomm * sc;
+	/*! The speed of the port: bytes per time unit (i.e., bytes per millisecond) */
+	uint32_t		rate;
+	/*!
+	 * Optional callback: the number of bytes waiting in the transmit queue of the port
+	 * (i.e., TIOCOUTQ). If it is NULL, the backlog is estimated from the rate.
+	 */
+	uint32_t		(* backlog)(struct sc_bond_port * port);
+	/*! Last argument of the backlog callback, free for the caller */
+	void *			priv;
+	/*! Internal usage: The estimated time, when the port finishes the sending */
+	uint32_t		busy_until;
+	/*! Statistics: The number of messages sent on the port */
+	uint32_t		tx_messages;
+	/*! Statistics: The number of bytes sent on the port */
+	uint32_t		tx_bytes;
+};
+
+/*! \brief Reorder buffer entry */
+struct sc_bond_slot {
+	/*! Non-zero, if the entry holds a message */
+	uint8_t			used;
+	/*! Message command value */
+	sc_cmd_t		cmd;
+	/*! The value of the comm. control field */
+	sc_cctrl_t		cctrl;
+	/*! The length of the message body */
+	sc_size_t		mlen;
+	/*! The arrival time */
+	uint32_t		time;
+};
+
+/*!
+ * \brief Bonded link
+ *
+ * It stripes one logical message stream across several physical ports. Each message gets a
+ * sequence number in the Timestamp field, and goes to the port which could finish its
+ * sending first (by the rate and the backlog of the ports). The receiver puts the messages
+ * of all ports back in order and calls the command callbacks of one struct sercomm_msg array.
+ *
+ * All ports should use the same layout with a 1, 2 or 4 bytes long Timestamp field.
+ *
+ * Example:
+ * \code
+ * static struct sc_bond_port ports[] = {
+ *     { .sc = &sc0, .rate = 92 },
+ *     { .sc = &sc1, .rate = 92 },
+ * };
+ * static struct sc_bond_slot slots[32];
+ * static unsigned char bodies[32 * (4 + 256)];
+ * static struct sc_bond bond = {
+ *     .ports = ports, .nports = 2, .sm = sms,
+ *     .slots = slots, .nslots = 32, .bodies = bodies, .slot_size = 4 + 256,
+ *     .timeout = 50,
+ * };
+ *
+ * sc_bond_init(&bond);
+ * p = sc_bond_make_message(&bond, now_ms(), MSG_COMMAND_LOG, 0, body, len, frame, sizeof(frame), &n);
+ * write(port_fd[p], frame, n);
+ * ...
+ * sc_bond_feed(&bond, p, buf, n, now_ms());   // on receive, on any port
+ * sc_bond_poll(&bond, now_ms());              // periodically
+ * \endcode
+ */
+struct sc_bond {
+	/*! The array of the physical ports */
+	struct sc_bond_port * ports;
+	/*! The number of the physical ports */
+	uint8_t			nports;
+	/*! The struct sercomm_msg array of the logical stream */
+	struct sercomm_msg * sm;
+	/*! Last priv argument of the command callbacks */
+	void *			priv;
+	/*! Reorder buffer entries */
+	struct sc_bond_slot * slots;
+	/*! The number of the reorder buffer entries (the reorder window) */
+	uint16_t		nslots;
+	/*! Reorder buffer storage: nslots * slot_size bytes */
+	unsigned char * bodies;
+	/*! The size of one entry: Timestamp field length + maximal body length */
+	sc_size_t		slot_size;
+	/*! The maximal waiting time for a missing message, before it is skipped */
+	uint32_t		timeout;
+	/*! Internal usage: The next sequence number to send */
+	uint32_t		tx_seq;
+	/*! Internal usage: The next sequence number to deliver */
+	uint32_t		rx_seq;
+	/*! Internal usage: The reorder buffer entry of rx_seq */
+	uint16_t		head;
+	/*! Internal usage: The number of messages in the reorder buffer */
+	uint16_t		held;
+	/*! Internal usage: The last time given to sc_bond_feed() or sc_bond_poll() */
+	uint32_t		now;
+	/*! Statistics: The number of delivered messages */
+	uint32_t		rx_messages;
+	/*! Statistics: The number of delivered messages, which arrived out of order */
+	uint32_t		rx_reordered;
+	/*! Statistics: The number of skipped (lost) sequence numbers */
+	uint32_t		rx_lost;
+	/*! Statistics: The number of dropped duplicated or too late messages */
+	uint32_t		rx_dropped;
+};
+
+/*!
+ * \brief Initialize the bonded link
+ *
+ * It resets the sequence numbers and the reorder buffer, and sets the frame callback and the
+ * priv field of the struct sercomm of each port.
+ *
+ * \param bond The bonded link
+ */
+void sc_bond_init(struct sc_bond * bond);
+
+/*!
+ * \brief Create a message, and select its port
+ *
+ * \param bond The bonded link
+ * \param now The current time, in the time unit of the port rates
+ * \param cmd Message command value
+ * \param cctrl The value of the comm. control field
+ * \param msg Message body
+ * \param mlen The length of the message body
+ * \param output The output buffer
+ * \param olen The size of the output buffer
+ * \param len Output: the length of the message with the header
+ *
+ * \return The index of the port to send the message on, or -1 if error occured
+ */
+int sc_bond_make_message(struct sc_bond * bond, uint32_t now, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        unsigned char * msg, sc_size_t mlen,
+        unsigned char * output, sc_size_t olen, sc_size_t * len);
+
+/*!
+ * \brief Process the received bytes of a port
+ *
+ * \param bond The bonded link
+ * \param port The index of the port
+ * \param data The received bytes
+ * \param len The number of the received bytes
+ * \param now The current time: the arrival time of the messages held for reordering
+ */
+void sc_bond_feed(struct sc_bond * bond, uint8_t port, const unsigned char * data, sc_size_t len,
+        uint32_t now);
+
+/*!
+ * \brief Skip the missing messages, which are waited for longer than the timeout
+ *
+ * Call it periodically.
+ *
+ * \param bond The bonded link
+ * \param now The current time
+ */
+void sc_bond_poll(struct sc_bond * bond, uint32_t now);
+
+/*!
+ * \brief Frame callback of the bonded link
+ *
+ * sc_bond_init() sets it in the struct sercomm of each port.
+ */
+void sc_bond_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+
@@ -0,0 +1,316 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Capability negotiation
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <string.h>
+
+#include "sercomm_crc.h"
+#include "sercomm_fec.h"
+#include "sercomm_caps.h"
+
+/* Version of the capability message body */
+#define CAPS_VERSION						1
+
+/* Little endian body: version, hashes, fast hashes, flags, max_len (4), window (2) */
+static void caps_encode(unsigned char * p, uint8_t hashes, uint8_t fast_hashes, uint8_t flags,
+        uint32_t max_len, uint16_t window)
+{
+    p[0] = CAPS_VERSION;
+    p[1] = hashes;
+    p[2] = fast_hashes;
+    p[3] = flags;
+    p[4] = (unsigned char)max_len;
+    p[5] = (unsigned char)(max_len >> 8);
+    p[6] = (unsigned char)(max_len >> 16);
+    p[7] = (unsigned char)(max_len >> 24);
+    p[8] = (unsigned char)window;
+    p[9] = (unsigned char)(window >> 8);
+}
+
+static uint32_t caps_u32(const unsigned char * p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void caps_send(struct sc_caps * caps, sc_cmd_t cmd, unsigned char * body)
+{
+    unsigned char frame[64 + SC_CAPS_BODY_LEN];
+    sc_size_t n;
+
+    n = sc_make_message(caps->sc, cmd, 0, body, SC_CAPS_BODY_LEN, frame, sizeof(frame));
+    if (n > 0)
+        caps->send(caps, frame, n);
+    caps->sent_time = caps->now;
+}
+
+/* The longest body, which fits in the parser buffer with the given hash and FEC parity */
+static uint32_t caps_buffer_len(struct sc_caps * caps, uint8_t hash, int fec)
+{
+    struct sercomm * sc = caps->sc;
+    struct sercomm_fec * fc = caps->fec;
+    uint32_t head = sc->cmd_bytes + sc->ts_bytes + sc->len_bytes, avail, tail;
+    uint32_t trailer = (hash == SC_CAPS_CRC32 ? 4 : 2) + sc->comm_ctrl_bytes;
+
+    if ((uint32_t)sc->buffer_size < sc->frame_start_bytes + head + trailer)
+        return 0;
+    avail = sc->buffer_size - sc->frame_start_bytes - head;
+    if (fec) {
+        //The header parity is dropped before the body is received
+        if (SC_FEC_PARITY_LEN(fc->k, head, fc->nsym_hdr) > avail)
+            return 0;
+        tail = (uint32_t)((uint64_t)avail * fc->k / (fc->k + fc->nsym));
+        while (tail > 0 && tail + SC_FEC_PARITY_LEN(fc->k, tail, fc->nsym) > avail)
+            tail--;
+    } else {
+        tail = avail;
+    }
+    return tail > trailer ? tail - trailer : 0;
+}
+
+/* The longest body of this end with the given options: the size type and the buffer limit it */
+static uint32_t caps_max_len(struct sc_caps * caps, uint8_t hash, int fec)
+{
+    uint32_t n = caps->local.max_len, b = caps_buffer_len(caps, hash, fec);
+
+    if (n > b)
+        n = b;
+    if (n > (sc_size_t)SERCOMM_IGNORE_MSG_VALID_LENGTH)
+        n = (sc_size_t)SERCOMM_IGNORE_MSG_VALID_LENGTH;
+    return n;
+}
+
+/* The capabilities sent in the hello: the length fits with the widest hash and the FEC */
+static void caps_local(struct sc_caps * caps, struct sc_caps_desc * d)
+{
+    *d = caps->local;
+    d->fec = caps->local.fec && caps->fec != NULL;
+    d->max_len = caps_max_len(caps, (d->hashes & SC_CAPS_CRC32) ? SC_CAPS_CRC32 : SC_CAPS_CRC16,
+            d->fec);
+}
+
+static void caps_send_hello(struct sc_caps * caps)
+{
+    unsigned char body[SC_CAPS_BODY_LEN];
+    struct sc_caps_desc d;
+
+    caps_local(caps, &d);
+    caps_encode(body, d.hashes, d.fast_hashes, (d.fec ? 0x01 : 0) | (d.fec_wanted ? 0x02 : 0),
+            d.max_len, d.window);
+    caps_send(caps, caps->hello_cmd, body);
+}
+
+static void caps_send_ack(struct sc_caps * caps)
+{
+    unsigned char body[SC_CAPS_BODY_LEN];
+
+    caps_encode(body, caps->result.hash, 0, caps->result.fec ? 0x01 : 0,
+            caps->result.max_len, caps->result.window);
+    caps_send(caps, caps->ack_cmd, body);
+}
+
+static void caps_base(struct sc_caps * caps)
+{
+    struct sercomm * sc = caps->sc;
+
+    sc->hash = caps->base_hash;
+    sc->hash_bytes = caps->base_hash_bytes;
+    sc->crcfix = caps->base_crcfix;
+    sc->fec = caps->base_fec;
+    sc->message_max_len = caps->base_max_len;
+}
+
+/* Switch the parser and the generator together, between two messages */
+static void caps_switch(struct sc_caps * caps)
+{
+    struct sercomm * sc = caps->sc;
+
+    if (caps->result.hash == SC_CAPS_CRC32) {
+        sc->hash = sc_crc32;
+        sc->hash_bytes = 4;
+    } else {
+        sc->hash = sc_crc16_ccitt;
+        sc->hash_bytes = 2;
+    }
+    //The syndrome table belongs to the base hash
+    sc->crcfix = NULL;
+    sc->fec = caps->result.fec ? caps->fec : NULL;
+    //Clamped by sc_caps_choose() and caps_acceptable()
+    sc->message_max_len = (sc_size_t)caps->result.max_len;
+    caps->state = SC_CAPS_DONE;
+    caps->negotiations++;
+    if (caps->done != NULL)
+        caps->done(caps, &caps->result);
+}
+
+void sc_caps_init(struct sc_caps * caps, struct sercomm * sc)
+{
+    caps->sc = sc;
+    caps->base_hash = sc->hash;
+    caps->base_hash_bytes = sc->hash_bytes;
+    caps->base_crcfix = sc->crcfix;
+    caps->base_fec = sc->fec;
+    caps->base_max_len = sc->message_max_len;
+    caps->state = SC_CAPS_IDLE;
+    sc->frame = sc_caps_frame;
+    sc->priv = caps;
+}
+
+void sc_caps_start(struct sc_caps * caps, uint32_t now)
+{
+    caps->now = now;
+    caps_base(caps);
+    caps->state = SC_CAPS_HELLO_SENT;
+    caps_send_hello(caps);
+}
+
+void sc_caps_poll(struct sc_caps * caps, uint32_t now)
+{
+    struct sercomm * sc = caps->sc;
+    unsigned char reset[32];
+    uint16_t n;
+
+    caps->now = now;
+    if (caps->state != SC_CAPS_HELLO_SENT && caps->state != SC_CAPS_ACK_SENT)
+        return;
+    if (now - caps->sent_time < caps->timeout)
+        return;
+    caps->retries++;
+    if (caps->state == SC_CAPS_HELLO_SENT) {
+        caps_send_hello(caps);
+        return;
+    }
+
+    //The acknowledge is lost: the peer could use the new options already. Reset both ends
+    if (sc->reset_bytes != SERCOMM_OMIT_RESET) {
+        memset(reset, sc->reset_byte, sizeof(reset));
+        for (n = sc->reset_bytes; n > 0; n -= n < sizeof(reset) ? n : sizeof(reset))
+            caps->send(caps, reset, n < sizeof(reset) ? n : sizeof(reset));
+    }
+    sc_caps_start(caps, now);
+}
+
+int sc_caps_ready(struct sc_caps * caps)
+{
+    return caps->state == SC_CAPS_IDLE || caps->state == SC_CAPS_DONE;
+}
+
+/* Rank of a hash: fast on both ends, then on one end, then the wider one */
+static int caps_rank(const struct sc_caps_desc * a, const struct sc_caps_desc * b, uint8_t hash)
+{
+    return ((a->fast_hashes & hash) != 0) + ((b->fast_hashes & hash) != 0);
+}
+
+int sc_caps_choose(const struct sc_caps_desc * a, const struct sc_caps_desc * b,
+        struct sc_caps_result * result)
+{
+    uint8_t common = a->hashes & b->hashes & (SC_CAPS_CRC16 | SC_CAPS_CRC32);
+
+    if (common == 0)
+        return -1;
+    if (common == (SC_CAPS_CRC16 | SC_CAPS_CRC32))
+        result->hash = caps_rank(a, b, SC_CAPS_CRC16) > caps_rank(a, b, SC_CAPS_CRC32) ?
+                SC_CAPS_CRC16 : SC_CAPS_CRC32;
+    else
+        result->hash = common;
+    result->fec = a->fec && b->fec && (a->fec_wanted || b->fec_wanted);
+    result->max_len = a->max_len < b->max_len ? a->max_len : b->max_len;
+    if (result->max_len > (sc_size_t)SERCOMM_IGNORE_MSG_VALID_LENGTH)
+        result->max_len = (sc_size_t)SERCOMM_IGNORE_MSG_VALID_LENGTH;
+    result->window = a->window < b->window ? a->window : b->window;
+    return 0;
+}
+
+static void caps_decode(const unsigned char * p, struct sc_caps_desc * d)
+{
+    d->hashes = p[1];
+    d->fast_hashes = p[2];
+    d->fec = (p[3] & 0x01) != 0;
+    d->fec_wanted = (p[3] & 0x02) != 0;
+    d->max_len = caps_u32(&p[4]);
+    d->window = (uint16_t)(p[8] | p[9] << 8);
+}
+
+/* The result of the peer is acceptable for this end */
+static int caps_acceptable(struct sc_caps * caps, const struct sc_caps_result * r)
+{
+    return (r->hash == SC_CAPS_CRC16 || r->hash == SC_CAPS_CRC32) &&
+        (caps->local.hashes & r->hash) && r->window <= caps->local.window &&
+        (!r->fec || (caps->local.fec && caps->fec != NULL)) &&
+        r->max_len <= caps_max_len(caps, r->hash, r->fec);
+}
+
+void sc_caps_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_caps * caps = sc->priv;
+    struct sc_caps_result r;
+    struct sc_caps_desc local;
+
+    (void)sm;
+    if ((f->cmd != caps->hello_cmd && f->cmd != caps->ack_cmd) || f->mlen != SC_CAPS_BODY_LEN ||
+            f->msg[0] != CAPS_VERSION) {
+        sc_dispatch(caps->sm, f, caps->priv);
+        return;
+    }
+
+    if (f->cmd == caps->hello_cmd) {
+        caps_decode(f->msg, &caps->peer);
+        if (caps->state != SC_CAPS_HELLO_SENT) {
+            //Started by the peer, or our hello is lost
+            if (caps->state == SC_CAPS_DONE)
+                caps_base(caps);
+            caps->state = SC_CAPS_HELLO_SENT;
+            caps_send_hello(caps);
+        }
+        caps_local(caps, &local);
+        if (sc_caps_choose(&local, &caps->peer, &caps->result) != 0)
+            return;
+        caps->state = SC_CAPS_ACK_SENT;
+        caps_send_ack(caps);
+        return;
+    }
+
+    r.hash = f->msg[1];
+    r.fec = (f->msg[3] & 0x01) != 0;
+    r.max_len = caps_u32(&f->msg[4]);
+    r.window = (uint16_t)(f->msg[8] | f->msg[9] << 8);
+    if (caps->state == SC_CAPS_ACK_SENT) {
+        //Both ends choose the same way from the same capabilities
+        if (r.hash == caps->result.hash && r.fec == caps->result.fec &&
+                r.max_len == caps->result.max_len && r.window == caps->result.window)
+            caps_switch(caps);
+        else
+            sc_caps_start(caps, caps->now);
+    } else if (caps->state == SC_CAPS_HELLO_SENT || caps->state == SC_CAPS_IDLE) {
+        //Our hello is received, but the hello of the peer is lost: take its result
+        if (!caps_acceptable(caps, &r)) {
+            sc_caps_start(caps, caps->now);
+            return;
+        }
+        caps->result = r;
+        caps->state = SC_CAPS_ACK_SENT;
+        caps_send_ack(caps);
+        caps_switch(caps);
+    }
+}
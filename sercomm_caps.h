@@ -0,0 +1,227 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Capability negotiation
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_CAPS_H
+#define _SERCOMM_CAPS_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief CRC-16/CCITT hash (sc_crc16_ccitt) */
+#define SC_CAPS_CRC16						0x01
+/*! \brief CRC-32 hash (sc_crc32) */
+#define SC_CAPS_CRC32						0x02
+/*! \brief The length of the capability message body */
+#define SC_CAPS_BODY_LEN					10
+
+/*! \brief Capabilities of one end */
+struct sc_caps_desc {
+	/*! The supported hashes: SC_CAPS_CRC16 and/or SC_CAPS_CRC32 */
+	uint8_t			hashes;
+	/*! The hashes, which are fast (i.e., hardware accelerated) on this end */
+	uint8_t			fast_hashes;
+	/*! FEC is supported (the fec field of struct sc_caps is set) */
+	uint8_t			fec;
+	/*! FEC is wanted (i.e., the line is noisy) */
+	uint8_t			fec_wanted;
+	/*! The longest message body, which could be received */
+	uint32_t		max_len;
+	/*! The largest window (i.e., of a reliable virtual channel) */
+	uint16_t		window;
+};
+
+/*! \brief Negotiated options */
+struct sc_caps_result {
+	/*! The hash: SC_CAPS_CRC16 or SC_CAPS_CRC32 */
+	uint8_t			hash;
+	/*! FEC is used */
+	uint8_t			fec;
+	/*! The longest message body */
+	uint32_t		max_len;
+	/*! The window */
+	uint16_t		window;
+};
+
+/*! \brief Negotiation states */
+enum sc_caps_state {
+	/*! The base layout is used, no negotiation is started */
+	SC_CAPS_IDLE = 0,
+	/*! The capabilities are sent */
+	SC_CAPS_HELLO_SENT,
+	/*! The result is sent, the result of the peer is waited */
+	SC_CAPS_ACK_SENT,
+	/*! The negotiated options are used */
+	SC_CAPS_DONE,
+};
+
+/*!
+ * \brief Capability negotiation
+ *
+ * The two ends exchange their capabilities at the link start (or after a reset sequence) in
+ * the base layout, i.e., the lowest common denominator. Each end chooses the options the same
+ * way from the two descriptors:
+ * - Hash: a common hash, which is fast on both ends, then on any end, then the wider one.
+ * - Message length: the smaller maximum of the two ends. Each end limits its maximum by the
+ *   size type and by the buffer of its parser, with its widest hash and FEC parity.
+ * - FEC: if both ends support it, and any end wants it.
+ * - Window: the smaller one of the two ends.
+ *
+ * Handshake: both ends send a hello message with their capabilities. An end, which knows both
+ * capabilities, sends an acknowledge with its result, and it switches to the result, when it
+ * has got the acknowledge of the peer too. The parser and the generator share the struct
+ * sercomm, so they are switched together, between two messages: the acknowledges are the last
+ * messages in the base layout in both directions. Do not send other messages while
+ * sc_caps_ready() returns zero after sc_caps_start().
+ *
+ * The CRC error correction is switched off, because its syndrome table belongs to one hash.
+ * The window is only negotiated: apply it, i.e., to struct sc_vc.
+ *
+ * Example:
+ * \code
+ * static struct sc_caps caps = {
+ *     .local = { .hashes = SC_CAPS_CRC16 | SC_CAPS_CRC32, .fast_hashes = SC_CAPS_CRC32,
+ *                .max_len = 1024, .window = 8 },
+ *     .hello_cmd = 0xF0, .ack_cmd = 0xF1, .sm = sms, .send = uart_send, .timeout = 500,
+ * };
+ *
+ * sc_caps_init(&caps, &sc);
+ * sc_caps_start(&caps, now_ms());
+ * ...
+ * sc_get_message(&sc, sms, byte);
+ * sc_caps_poll(&caps, now_ms());              // periodically, for the retries
+ * \endcode
+ */
+struct sc_caps {
+	/*! The local capabilities */
+	struct sc_caps_desc local;
+	/*! FEC configuration to use, if it is negotiated. NULL, if not supported */
+	struct sercomm_fec * fec;
+	/*! The command of the hello message */
+	sc_cmd_t		hello_cmd;
+	/*! The command of the acknowledge message */
+	sc_cmd_t		ack_cmd;
+	/*! The struct sercomm_msg array of the other commands */
+	struct sercomm_msg * sm;
+	/*! Last priv argument of the command callbacks */
+	void *			priv;
+	/*! Send callback of the handshake messages */
+	void			(* send)(struct sc_caps * caps, const unsigned char * frame, sc_size_t len);
+	/*! Optional callback of the switch to the negotiated options */
+	void			(* done)(struct sc_caps * caps, const struct sc_caps_result * result);
+	/*! The time between the retries of the handshake */
+	uint32_t		timeout;
+	/*! The state of the negotiation */
+	enum sc_caps_state state;
+	/*! The negotiated options (valid in SC_CAPS_DONE) */
+	struct sc_caps_result result;
+	/*! Internal usage: The parser and generator */
+	struct sercomm * sc;
+	/*! Internal usage: The hash of the base layout */
+	void			(* base_hash)(unsigned char * hashptr, unsigned char * msg, int mlen);
+	/*! Internal usage: The hash length of the base layout */
+	uint8_t			base_hash_bytes;
+	/*! Internal usage: The CRC error correction of the base layout */
+	struct sercomm_crcfix * base_crcfix;
+	/*! Internal usage: The FEC of the base layout */
+	struct sercomm_fec * base_fec;
+	/*! Internal usage: The maximal message length of the base layout */
+	sc_size_t		base_max_len;
+	/*! Internal usage: The capabilities of the peer */
+	struct sc_caps_desc peer;
+	/*! Internal usage: The time of the last handshake message */
+	uint32_t		sent_time;
+	/*! Internal usage: The last time given to the library */
+	uint32_t		now;
+	/*! Statistics: The number of the completed negotiations */
+	uint32_t		negotiations;
+	/*! Statistics: The number of the retries */
+	uint32_t		retries;
+};
+
+/*!
+ * \brief Initialize the capability negotiation
+ *
+ * It saves the base layout of sc, and sets the frame callback and the priv field of sc.
+ *
+ * \param caps The capability negotiation
+ * \param sc The parser and generator
+ */
+void sc_caps_init(struct sc_caps * caps, struct sercomm * sc);
+
+/*!
+ * \brief Start the negotiation
+ *
+ * It switches back to the base layout, and sends the hello message. Call it at the link
+ * start, and from the reset callback.
+ *
+ * \param caps The capability negotiation
+ * \param now The current time
+ */
+void sc_caps_start(struct sc_caps * caps, uint32_t now);
+
+/*!
+ * \brief Retry the handshake after the timeout
+ *
+ * Call it periodically.
+ *
+ * \param caps The capability negotiation
+ * \param now The current time
+ */
+void sc_caps_poll(struct sc_caps * caps, uint32_t now);
+
+/*!
+ * \brief Check, whether the other messages could be sent
+ *
+ * \param caps The capability negotiation
+ *
+ * \return Non-zero, if no negotiation is in progress
+ */
+int sc_caps_ready(struct sc_caps * caps);
+
+/*!
+ * \brief Choose the options from two capability descriptors
+ *
+ * The result does not depend on the order of the descriptors.
+ *
+ * \param a The capabilities of one end
+ * \param b The capabilities of the other end
+ * \param result Output: the chosen options
+ *
+ * \return Zero on success, or -1 if there is no common hash
+ */
+int sc_caps_choose(const struct sc_caps_desc * a, const struct sc_caps_desc * b,
+        struct sc_caps_result * result);
+
+/*!
+ * \brief Frame callback of the capability negotiation
+ *
+ * sc_caps_init() sets it in the parser.
+ */
+void sc_caps_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+
@@ -0,0 +1,714 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Raw capture with seek index
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sercomm_capture.h"
+
+#define CAPTURE_PATH_MAX    4096
+#define CAPTURE_ZMAGIC      0x315A4353      /* "SCZ1" */
+#define CAPTURE_IMAGIC      0x31494353      /* "SCI1" */
+/* The number of the full blocks waiting for the compressor thread */
+#define CAPTURE_QUEUE       4
+/* LZ parameters: minimal match, hash table size, the literals at the end of a block */
+#define LZ_MINMATCH         4
+#define LZ_HASH_BITS        13
+#define LZ_LAST_LITERALS    5
+#define LZ_MAX_OFFSET       65535
+
+/* Sync point in the index file */
+struct capture_sync {
+    uint64_t            offset;
+    uint32_t            time;
+    uint32_t            reserved;
+};
+
+/*
+ * Header of the index file, in the place of the first sync point. The format of the capture
+ * file is recorded here: the raw bytes could start with anything, even with CAPTURE_ZMAGIC.
+ */
+struct capture_ihdr {
+    uint32_t            magic;
+    uint32_t            block_size;     /* Zero, if the capture is not compressed */
+    uint64_t            reserved;
+};
+
+/* Header of a compressed block. If stored_len == raw_len, the block is not compressed */
+struct capture_zhdr {
+    uint32_t            magic;
+    uint32_t            raw_len;
+    uint32_t            stored_len;
+    uint32_t            reserved;
+    uint64_t            raw_off;
+};
+
+/* Block index entry in memory */
+struct capture_zblock {
+    uint64_t            raw_off;
+    uint64_t            file_off;
+    uint32_t            raw_len;
+    uint32_t            stored_len;
+};
+
+struct sc_capture {
+    FILE *              data;
+    FILE *              index;
+    uint32_t            interval;
+    uint64_t            offset;         /* The number of the captured bytes */
+    uint64_t            next_sync;      /* The first offset of the next sync point */
+    /* Compression */
+    uint32_t            block_size;     /* Zero, if the capture is not compressed */
+    unsigned char *     cur;            /* The block under filling */
+    uint32_t            cur_len;
+    unsigned char *     queue[CAPTURE_QUEUE];
+    uint32_t            queue_len[CAPTURE_QUEUE];
+    unsigned char *     spare[CAPTURE_QUEUE + 1];
+    int                 qhead, qcount, nspare;
+    uint64_t            file_off;
+    uint64_t            zraw_off;       /* The raw offset of the next compressed block */
+    unsigned char *     zbuf;
+    int                 stop;
+    int                 error;
+    int                 thread_started;
+    pthread_t           thread;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+};
+
+struct sc_capture_reader {
+    int                 fd;
+    struct capture_sync * sync;         /* The mapped index, after the header */
+    size_t              nsync;
+    uint64_t            pos;
+    uint64_t            size;           /* The raw size */
+    struct capture_zblock * blocks;     /* NULL, if the capture is not compressed */
+    size_t              nblocks;
+    uint32_t            max_block;
+    struct sc_capture_cache * cache;    /* The cache of sc_capture_read() */
+};
+
+struct sc_capture_cache {
+    unsigned char *     stored;
+    unsigned char *     raw;
+    size_t              block;          /* The decompressed block in raw, or SIZE_MAX */
+    uint32_t            size;           /* The size of the buffers */
+};
+
+static void capture_index_path(char * dst, const char * path)
+{
+    snprintf(dst, CAPTURE_PATH_MAX, "%s.idx", path);
+}
+
+static uint32_t lz_hash(const unsigned char * p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static unsigned char * lz_length(unsigned char * op, uint32_t len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+/*
+ * Greedy LZ77 with an LZ4 style token format: the repeated Frame start and header bytes of
+ * the messages become short matches. It returns the compressed length, or zero if the output
+ * would not be shorter than the input.
+ */
+static uint32_t lz_compress(const unsigned char * in, uint32_t len, unsigned char * out)
+{
+    uint32_t table[1 << LZ_HASH_BITS];
+    const unsigned char * ip = in, * anchor = in, * ref, * end = in + len;
+    const unsigned char * limit = len > LZ_LAST_LITERALS + LZ_MINMATCH ? end - LZ_LAST_LITERALS - LZ_MINMATCH : in;
+    unsigned char * op = out, * oend = out + len, * token;
+    uint32_t h, lit, mlen;
+
+    memset(table, 0xFF, sizeof(table));
+    while (ip < limit) {
+        h = lz_hash(ip);
+        ref = table[h] == UINT32_MAX ? NULL : in + table[h];
+        table[h] = (uint32_t)(ip - in);
+        if (ref == NULL || ip - ref > LZ_MAX_OFFSET || memcmp(ref, ip, LZ_MINMATCH)) {
+            ip++;
+            continue;
+        }
+        for (mlen = LZ_MINMATCH; ip + mlen < end - LZ_LAST_LITERALS && ref[mlen] == ip[mlen]; mlen++)
+            ;
+        lit = (uint32_t)(ip - anchor);
+        //Token, lengths, literals, offset: the worst case size
+        if (op + 1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1 >= oend)
+            return 0;
+        token = op++;
+        *token = (unsigned char)((lit < 15 ? lit : 15) << 4);
+        if (lit >= 15)
+            op = lz_length(op, lit - 15);
+        memcpy(op, anchor, lit);
+        op += lit;
+        *op++ = (unsigned char)(ip - ref);
+        *op++ = (unsigned char)((ip - ref) >> 8);
+        *token |= (unsigned char)(mlen - LZ_MINMATCH < 15 ? mlen - LZ_MINMATCH : 15);
+        if (mlen - LZ_MINMATCH >= 15)
+            op = lz_length(op, mlen - LZ_MINMATCH - 15);
+        ip += mlen;
+        anchor = ip;
+    }
+    lit = (uint32_t)(end - anchor);
+    if (op + 1 + lit / 255 + 1 + lit >= oend)
+        return 0;
+    token = op++;
+    *token = (unsigned char)((lit < 15 ? lit : 15) << 4);
+    if (lit >= 15)
+        op = lz_length(op, lit - 15);
+    memcpy(op, anchor, lit);
+    op += lit;
+    return (uint32_t)(op - out);
+}
+
+static int lz_read_length(const unsigned char ** ip, const unsigned char * iend, uint32_t * len)
+{
+    unsigned char b;
+
+    do {
+        if (*ip >= iend)
+            return -1;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+/* It returns zero, if the block is decompressed to exactly len bytes */
+static int lz_decompress(const unsigned char * in, uint32_t ilen, unsigned char * out, uint32_t len)
+{
+    const unsigned char * ip = in, * iend = in + ilen;
+    unsigned char * op = out, * oend = out + len;
+    uint32_t lit, mlen, off;
+    unsigned char token;
+
+    while (ip < iend) {
+        token = *ip++;
+        lit = token >> 4;
+        if (lit == 15 && lz_read_length(&ip, iend, &lit) < 0)
+            return -1;
+        if (lit > (uint32_t)(iend - ip) || lit > (uint32_t)(oend - op))
+            return -1;
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend)
+            break;
+        if (iend - ip < 2)
+            return -1;
+        off = ip[0] | (uint32_t)ip[1] << 8;
+        ip += 2;
+        mlen = (token & 15);
+        if (mlen == 15 && lz_read_length(&ip, iend, &mlen) < 0)
+            return -1;
+        mlen += LZ_MINMATCH;
+        if (off == 0 || off > (uint32_t)(op - out) || mlen > (uint32_t)(oend - op))
+            return -1;
+        //Overlapping copy: byte by byte
+        for (; mlen > 0; mlen--, op++)
+            *op = op[-(long)off];
+    }
+    return op == oend ? 0 : -1;
+}
+
+/* Compress and write a block. Only the compressor thread calls it */
+static int capture_zwrite(struct sc_capture * cap, const unsigned char * raw, uint32_t len)
+{
+    struct capture_zhdr h;
+    uint32_t n;
+
+    n = lz_compress(raw, len, cap->zbuf);
+    h.magic = CAPTURE_ZMAGIC;
+    h.raw_len = len;
+    h.stored_len = n > 0 ? n : len;
+    h.reserved = 0;
+    h.raw_off = cap->zraw_off;
+    if (fwrite(&h, sizeof(h), 1, cap->data) != 1 ||
+            fwrite(n > 0 ? cap->zbuf : raw, 1, h.stored_len, cap->data) != h.stored_len)
+        return -1;
+    cap->zraw_off += len;
+    cap->file_off += sizeof(h) + h.stored_len;
+    return 0;
+}
+
+static void * capture_zmain(void * arg)
+{
+    struct sc_capture * cap = arg;
+    unsigned char * blk;
+    uint32_t len;
+    int err;
+
+    pthread_mutex_lock(&cap->lock);
+    for (;;) {
+        while (cap->qcount == 0 && !cap->stop)
+            pthread_cond_wait(&cap->cond, &cap->lock);
+        if (cap->qcount == 0)
+            break;
+        blk = cap->queue[cap->qhead];
+        len = cap->queue_len[cap->qhead];
+        pthread_mutex_unlock(&cap->lock);
+
+        //The writing runs without the lock: the receive path only waits, if the queue is full
+        err = capture_zwrite(cap, blk, len);
+
+        pthread_mutex_lock(&cap->lock);
+        if (err < 0)
+            cap->error = 1;
+        cap->qhead = (cap->qhead + 1) % CAPTURE_QUEUE;
+        cap->qcount--;
+        cap->spare[cap->nspare++] = blk;
+        pthread_cond_broadcast(&cap->cond);
+    }
+    pthread_mutex_unlock(&cap->lock);
+    return NULL;
+}
+
+/* Hand the current block to the compressor thread */
+static int capture_zflush(struct sc_capture * cap)
+{
+    int ret;
+
+    if (cap->cur_len == 0)
+        return 0;
+    pthread_mutex_lock(&cap->lock);
+    while (cap->qcount == CAPTURE_QUEUE || cap->nspare == 0)
+        pthread_cond_wait(&cap->cond, &cap->lock);
+    cap->queue[(cap->qhead + cap->qcount) % CAPTURE_QUEUE] = cap->cur;
+    cap->queue_len[(cap->qhead + cap->qcount) % CAPTURE_QUEUE] = cap->cur_len;
+    cap->qcount++;
+    cap->cur = cap->spare[--cap->nspare];
+    cap->cur_len = 0;
+    ret = cap->error ? -1 : 0;
+    pthread_cond_broadcast(&cap->cond);
+    pthread_mutex_unlock(&cap->lock);
+    return ret;
+}
+
+static int capture_write(struct sc_capture * cap, const unsigned char * data, size_t len)
+{
+    uint32_t n;
+
+    if (cap->block_size == 0)
+        return fwrite(data, 1, len, cap->data) == len ? 0 : -1;
+    while (len > 0) {
+        n = cap->block_size - cap->cur_len;
+        if (n > len)
+            n = (uint32_t)len;
+        memcpy(cap->cur + cap->cur_len, data, n);
+        cap->cur_len += n;
+        data += n;
+        len -= n;
+        if (cap->cur_len == cap->block_size && capture_zflush(cap) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+struct sc_capture * sc_capture_open(const char * path, uint32_t interval)
+{
+    return sc_capture_open_compressed(path, interval, 0);
+}
+
+struct sc_capture * sc_capture_open_compressed(const char * path, uint32_t interval, uint32_t block_size)
+{
+    char ipath[CAPTURE_PATH_MAX];
+    struct sc_capture * cap;
+    struct capture_ihdr h;
+    int i;
+
+    cap = calloc(1, sizeof(*cap));
+    if (cap == NULL)
+        return NULL;
+    cap->interval = interval;
+    cap->block_size = block_size;
+    if (block_size > 0) {
+        pthread_mutex_init(&cap->lock, NULL);
+        pthread_cond_init(&cap->cond, NULL);
+    }
+    cap->data = fopen(path, "wb");
+    capture_index_path(ipath, path);
+    cap->index = fopen(ipath, "wb");
+    if (cap->data == NULL || cap->index == NULL)
+        goto error;
+    h.magic = CAPTURE_IMAGIC;
+    h.block_size = block_size;
+    h.reserved = 0;
+    if (fwrite(&h, sizeof(h), 1, cap->index) != 1)
+        goto error;
+    if (block_size == 0)
+        return cap;
+
+    cap->cur = malloc(block_size);
+    cap->zbuf = malloc(block_size);
+    if (cap->cur == NULL || cap->zbuf == NULL)
+        goto error;
+    for (i = 0; i < CAPTURE_QUEUE; i++) {
+        cap->spare[i] = malloc(block_size);
+        if (cap->spare[i] == NULL)
+            goto error;
+        cap->nspare++;
+    }
+    if (pthread_create(&cap->thread, NULL, capture_zmain, cap) != 0)
+        goto error;
+    cap->thread_started = 1;
+    return cap;
+
+error:
+    sc_capture_close(cap);
+    return NULL;
+}
+
+int sc_capture_feed(struct sc_capture * cap, struct sercomm * sc, struct sercomm_msg * sm,
+        const unsigned char * data, size_t len, uint32_t time)
+{
+    struct capture_sync s;
+    size_t i;
+    int ret = 0;
+
+    for (i = 0; i < len; i++) {
+        sc_get_message(sc, sm, data[i]);
+        //The parser has just matched a Frame start: a new parser would be in the same state
+        if (cap->offset + i + 1 >= cap->next_sync + sc->frame_start_bytes &&
+                sc->frame_start_bytes > 0 && sc->buffer_len == sc->frame_start_bytes) {
+            s.offset = cap->offset + i + 1 - sc->frame_start_bytes;
+            s.time = time;
+            s.reserved = 0;
+            if (fwrite(&s, sizeof(s), 1, cap->index) != 1)
+                ret = -1;
+            cap->next_sync = s.offset + cap->interval;
+        }
+    }
+    if (capture_write(cap, data, len) < 0)
+        ret = -1;
+    cap->offset += len;
+    return ret;
+}
+
+int sc_capture_close(struct sc_capture * cap)
+{
+    int ret = 0, i;
+
+    if (cap->block_size > 0) {
+        if (cap->thread_started) {
+            if (capture_zflush(cap) < 0)
+                ret = -1;
+            pthread_mutex_lock(&cap->lock);
+            cap->stop = 1;
+            pthread_cond_broadcast(&cap->cond);
+            pthread_mutex_unlock(&cap->lock);
+            pthread_join(cap->thread, NULL);
+            if (cap->error || cap->data == NULL)
+                ret = -1;
+        }
+        for (i = 0; i < cap->nspare; i++)
+            free(cap->spare[i]);
+        free(cap->cur);
+        free(cap->zbuf);
+        pthread_cond_destroy(&cap->cond);
+        pthread_mutex_destroy(&cap->lock);
+    }
+    if (cap->data != NULL && fclose(cap->data) != 0)
+        ret = -1;
+    if (cap->index != NULL && fclose(cap->index) != 0)
+        ret = -1;
+    free(cap);
+    return ret;
+}
+
+/* Build the block table of a compressed capture from the block headers */
+static int capture_zscan(struct sc_capture_reader * r, uint64_t file_size)
+{
+    struct capture_zhdr h;
+    struct capture_zblock * b;
+    uint64_t off = 0;
+    size_t size = 0;
+
+    while (off + sizeof(h) <= file_size) {
+        if (pread(r->fd, &h, sizeof(h), (off_t)off) != sizeof(h) || h.magic != CAPTURE_ZMAGIC ||
+                h.stored_len > h.raw_len || off + sizeof(h) + h.stored_len > file_size ||
+                h.raw_off != r->size)
+            break;
+        if (r->nblocks == size) {
+            size = size ? size * 2 : 256;
+            b = realloc(r->blocks, size * sizeof(*b));
+            if (b == NULL)
+                return -1;
+            r->blocks = b;
+        }
+        b = &r->blocks[r->nblocks++];
+        b->raw_off = h.raw_off;
+        b->file_off = off + sizeof(h);
+        b->raw_len = h.raw_len;
+        b->stored_len = h.stored_len;
+        if (h.raw_len > r->max_block)
+            r->max_block = h.raw_len;
+        r->size += h.raw_len;
+        off += sizeof(h) + h.stored_len;
+    }
+    return 0;
+}
+
+struct sc_capture_reader * sc_capture_reader_open(const char * path)
+{
+    char ipath[CAPTURE_PATH_MAX];
+    struct sc_capture_reader * r;
+    struct capture_ihdr h;
+    struct stat st;
+    int fd = -1;
+
+    r = calloc(1, sizeof(*r));
+    if (r == NULL)
+        return NULL;
+    r->fd = open(path, O_RDONLY);
+    capture_index_path(ipath, path);
+    fd = open(ipath, O_RDONLY);
+    if (r->fd < 0 || fd < 0 || pread(fd, &h, sizeof(h), 0) != sizeof(h) || h.magic != CAPTURE_IMAGIC)
+        goto error;
+
+    if (fstat(r->fd, &st) < 0)
+        goto error;
+    if (h.block_size > 0) {
+        //A torn block at the end is ignored
+        if (capture_zscan(r, (uint64_t)st.st_size) < 0)
+            goto error;
+    } else {
+        r->size = (uint64_t)st.st_size;
+    }
+
+    if (fstat(fd, &st) < 0)
+        goto error;
+    //A torn entry at the end is ignored. The header is mapped too, for the alignment
+    r->nsync = st.st_size / sizeof(struct capture_sync) - 1;
+    if (r->nsync > 0) {
+        r->sync = mmap(NULL, (r->nsync + 1) * sizeof(struct capture_sync), PROT_READ, MAP_SHARED, fd, 0);
+        if (r->sync == MAP_FAILED) {
+            r->sync = NULL;
+            goto error;
+        }
+        r->sync++;
+    }
+    close(fd);
+    return r;
+
+error:
+    if (fd >= 0)
+        close(fd);
+    sc_capture_reader_close(r);
+    return NULL;
+}
+
+int sc_capture_seek(struct sc_capture_reader * r, uint32_t time, uint64_t * offset, uint32_t * sync_time)
+{
+    size_t lo = 0, hi = r->nsync, mid;
+    uint64_t off = 0;
+    uint32_t t = 0;
+
+    //The first sync point after time
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (r->sync[mid].time <= time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo > 0) {
+        off = r->sync[lo - 1].offset;
+        t = r->sync[lo - 1].time;
+    }
+    r->pos = off;
+    if (offset != NULL)
+        *offset = off;
+    if (sync_time != NULL)
+        *sync_time = t;
+    return 0;
+}
+
+struct sc_capture_cache * sc_capture_cache_open(struct sc_capture_reader * r)
+{
+    struct sc_capture_cache * c;
+
+    c = calloc(1, sizeof(*c));
+    if (c == NULL)
+        return NULL;
+    c->block = SIZE_MAX;
+    //An uncompressed capture is read directly
+    if (r->blocks != NULL) {
+        c->size = r->max_block;
+        c->stored = malloc(c->size);
+        c->raw = malloc(c->size);
+        if (c->stored == NULL || c->raw == NULL) {
+            sc_capture_cache_close(c);
+            return NULL;
+        }
+    }
+    return c;
+}
+
+void sc_capture_cache_close(struct sc_capture_cache * c)
+{
+    if (c == NULL)
+        return;
+    free(c->stored);
+    free(c->raw);
+    free(c);
+}
+
+/* Decompress a block into the cache, unless it is there already */
+static int capture_zload(struct sc_capture_reader * r, struct sc_capture_cache * c, size_t i)
+{
+    struct capture_zblock * b = &r->blocks[i];
+
+    if (c->block == i)
+        return 0;
+    c->block = SIZE_MAX;
+    if (b->raw_len > c->size || b->stored_len > c->size)
+        return -1;
+    if (pread(r->fd, c->stored, b->stored_len, (off_t)b->file_off) != (ssize_t)b->stored_len)
+        return -1;
+    if (b->stored_len == b->raw_len)
+        memcpy(c->raw, c->stored, b->raw_len);
+    else if (lz_decompress(c->stored, b->stored_len, c->raw, b->raw_len) < 0)
+        return -1;
+    c->block = i;
+    return 0;
+}
+
+/* Read from a compressed capture: decompress the blocks of the range */
+static long capture_zpread(struct sc_capture_reader * r, struct sc_capture_cache * c,
+        unsigned char * buf, size_t len, uint64_t offset)
+{
+    struct capture_zblock * b;
+    size_t lo = 0, hi = r->nblocks, mid, done = 0;
+    uint32_t skip, n;
+
+    if (offset >= r->size)
+        return 0;
+    //The block of offset
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+        if (r->blocks[mid].raw_off <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    for (; lo < r->nblocks && done < len; lo++) {
+        if (capture_zload(r, c, lo) < 0)
+            break;
+        b = &r->blocks[lo];
+        skip = (uint32_t)(offset + done - b->raw_off);
+        n = b->raw_len - skip;
+        if (n > len - done)
+            n = (uint32_t)(len - done);
+        memcpy(buf + done, c->raw + skip, n);
+        done += n;
+    }
+    return done > 0 ? (long)done : -1;
+}
+
+long sc_capture_read(struct sc_capture_reader * r, unsigned char * buf, size_t len)
+{
+    long n;
+
+    if (r->blocks != NULL && r->cache == NULL) {
+        r->cache = sc_capture_cache_open(r);
+        if (r->cache == NULL)
+            return -1;
+    }
+    n = sc_capture_pread_cached(r, r->cache, buf, len, r->pos);
+    if (n > 0)
+        r->pos += n;
+    return n;
+}
+
+long sc_capture_pread_cached(struct sc_capture_reader * r, struct sc_capture_cache * c,
+        unsigned char * buf, size_t len, uint64_t offset)
+{
+    if (r->blocks != NULL)
+        return capture_zpread(r, c, buf, len, offset);
+    return (long)pread(r->fd, buf, len, (off_t)offset);
+}
+
+long sc_capture_pread(struct sc_capture_reader * r, unsigned char * buf, size_t len, uint64_t offset)
+{
+    struct sc_capture_cache * c;
+    long n;
+
+    if (r->blocks == NULL)
+        return (long)pread(r->fd, buf, len, (off_t)offset);
+    c = sc_capture_cache_open(r);
+    if (c == NULL)
+        return -1;
+    n = capture_zpread(r, c, buf, len, offset);
+    sc_capture_cache_close(c);
+    return n;
+}
+
+uint64_t sc_capture_size(struct sc_capture_reader * r)
+{
+    return r->size;
+}
+
+size_t sc_capture_sync_count(struct sc_capture_reader * r)
+{
+    return r->nsync;
+}
+
+int sc_capture_sync_point(struct sc_capture_reader * r, size_t i, uint64_t * offset, uint32_t * time)
+{
+    if (i >= r->nsync)
+        return -1;
+    if (offset != NULL)
+        *offset = r->sync[i].offset;
+    if (time != NULL)
+        *time = r->sync[i].time;
+    return 0;
+}
+
+void sc_capture_reader_close(struct sc_capture_reader * r)
+{
+    if (r->sync != NULL)
+        munmap(r->sync - 1, (r->nsync + 1) * sizeof(struct capture_sync));
+    if (r->fd >= 0)
+        close(r->fd);
+    sc_capture_cache_close(r->cache);
+    free(r->blocks);
+    free(r);
+}
@@ -0,0 +1,244 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Raw capture with seek index
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_CAPTURE_H
+#define _SERCOMM_CAPTURE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "sercomm.h"
+
+/*!
+ * \brief Raw capture with seek index (POSIX host only)
+ *
+ * The capture file has the received bytes as they are. sc_capture_feed() writes them, and it
+ * passes them to sc_get_message() too. When the parser has just matched a Frame start
+ * sequence, its state is the same as the state of a new parser after the same bytes. So
+ * parsing from that offset gives the same messages. After every interval bytes, the next such
+ * offset is a sync point: it is appended with the receive time to the sidecar index file
+ * (path with ".idx"). The index file starts with a header, which records the format of the
+ * capture file.
+ *
+ * The reader looks up the last sync point before a time by binary search in the index, and
+ * a new parser could start from there immediately. The receive times should not decrease.
+ * The Frame start should be at least one byte long.
+ *
+ * A compressed capture (sc_capture_open_compressed()) is a sequence of independent blocks.
+ * The receive path only copies the bytes into the current block, and a background thread
+ * compresses and writes the full blocks. The compression is a fast LZ77: the Frame start
+ * and the header fields repeat in every message, and they become short back references.
+ * Each block has a header with its raw offset, so the reader finds the block of an offset
+ * by binary search, and more threads could decompress different blocks in parallel.
+ * The reader takes the format from the index file, and the sync points keep the raw offsets.
+ *
+ * Example:
+ * \code
+ * struct sc_capture * cap = sc_capture_open("/var/log/gw/port7.cap", 1 << 20);
+ *
+ * n = read(fd, buf, sizeof(buf));
+ * sc_capture_feed(cap, &sc, sms, buf, n, now_ms());
+ * ...
+ * struct sc_capture_reader * r = sc_capture_reader_open("/var/log/gw/port7.cap");
+ *
+ * sc_capture_seek(r, t, NULL, NULL);
+ * while ((n = sc_capture_read(r, buf, sizeof(buf))) > 0)
+ *     for (i = 0; i < n; i++)
+ *         sc_get_message(&sc_replay, sms, buf[i]);
+ * \endcode
+ */
+struct sc_capture;
+
+/*! \brief Capture reader */
+struct sc_capture_reader;
+
+/*! \brief Decompressed block cache of a reader thread */
+struct sc_capture_cache;
+
+/*!
+ * \brief Create a capture file and its index
+ *
+ * \param path The capture file
+ * \param interval The minimal number of bytes between the sync points
+ *
+ * \return The capture, or NULL if error occured
+ */
+struct sc_capture * sc_capture_open(const char * path, uint32_t interval);
+
+/*!
+ * \brief Create a compressed capture file and its index
+ *
+ * \param path The capture file
+ * \param interval The minimal number of bytes between the sync points
+ * \param block_size The raw size of the compressed blocks (i.e., 1 MiB). Zero to disable the compression
+ *
+ * \return The capture, or NULL if error occured
+ */
+struct sc_capture * sc_capture_open_compressed(const char * path, uint32_t interval, uint32_t block_size);
+
+/*!
+ * \brief Capture and parse the received bytes
+ *
+ * \param cap The capture
+ * \param sc The parser of the link
+ * \param sm The struct sercomm_msg array
+ * \param data The received bytes
+ * \param len The number of the received bytes
+ * \param time The receive time
+ *
+ * \return Zero on success, or -1 if the write failed
+ */
+int sc_capture_feed(struct sc_capture * cap, struct sercomm * sc, struct sercomm_msg * sm,
+        const unsigned char * data, size_t len, uint32_t time);
+
+/*!
+ * \brief Flush and close the capture
+ *
+ * \param cap The capture
+ *
+ * \return Zero on success, or -1 if the write failed
+ */
+int sc_capture_close(struct sc_capture * cap);
+
+/*!
+ * \brief Open a capture file and its index for reading
+ *
+ * \param path The capture file
+ *
+ * \return The reader, or NULL if error occured
+ */
+struct sc_capture_reader * sc_capture_reader_open(const char * path);
+
+/*!
+ * \brief Seek to the last sync point at or before a time
+ *
+ * \param r The reader
+ * \param time The time
+ * \param offset Output: the offset of the sync point (zero, if there is none before time). NULL to omit
+ * \param sync_time Output: the time of the sync point. NULL to omit
+ *
+ * \return Zero on success, or -1 if error occured
+ */
+int sc_capture_seek(struct sc_capture_reader * r, uint32_t time, uint64_t * offset, uint32_t * sync_time);
+
+/*!
+ * \brief Read the capture from the current position
+ *
+ * \param r The reader
+ * \param buf The output buffer
+ * \param len The size of the output buffer
+ *
+ * \return The number of the read bytes, zero at the end, or -1 if error occured
+ */
+long sc_capture_read(struct sc_capture_reader * r, unsigned char * buf, size_t len);
+
+/*!
+ * \brief Read the capture from an offset
+ *
+ * It does not change the current position, so more threads could use it. A compressed
+ * block is decompressed at every call: use sc_capture_pread_cached() for the sequential
+ * reads.
+ *
+ * \param r The reader
+ * \param buf The output buffer
+ * \param len The size of the output buffer
+ * \param offset The offset in the capture
+ *
+ * \return The number of the read bytes, zero at the end, or -1 if error occured
+ */
+long sc_capture_pread(struct sc_capture_reader * r, unsigned char * buf, size_t len, uint64_t offset);
+
+/*!
+ * \brief Create a cache for sc_capture_pread_cached()
+ *
+ * It holds the last decompressed block and the decompression buffers. Each thread needs
+ * its own cache.
+ *
+ * \param r The reader
+ *
+ * \return The cache, or NULL if error occured
+ */
+struct sc_capture_cache * sc_capture_cache_open(struct sc_capture_reader * r);
+
+/*!
+ * \brief Read the capture from an offset through a cache
+ *
+ * Like sc_capture_pread(), but the smaller reads of a compressed block decompress it
+ * only once.
+ *
+ * \param r The reader
+ * \param c The cache of the calling thread
+ * \param buf The output buffer
+ * \param len The size of the output buffer
+ * \param offset The offset in the capture
+ *
+ * \return The number of the read bytes, zero at the end, or -1 if error occured
+ */
+long sc_capture_pread_cached(struct sc_capture_reader * r, struct sc_capture_cache * c,
+        unsigned char * buf, size_t len, uint64_t offset);
+
+/*!
+ * \brief Free a cache
+ *
+ * \param c The cache
+ */
+void sc_capture_cache_close(struct sc_capture_cache * c);
+
+/*!
+ * \brief Get the raw size of the capture
+ *
+ * \param r The reader
+ */
+uint64_t sc_capture_size(struct sc_capture_reader * r);
+
+/*!
+ * \brief Get the number of the sync points
+ *
+ * \param r The reader
+ */
+size_t sc_capture_sync_count(struct sc_capture_reader * r);
+
+/*!
+ * \brief Get a sync point
+ *
+ * \param r The reader
+ * \param i The index of the sync point
+ * \param offset Output: the offset of the sync point. NULL to omit
+ * \param time Output: the time of the sync point. NULL to omit
+ *
+ * \return Zero on success, or -1 if there is no such sync point
+ */
+int sc_capture_sync_point(struct sc_capture_reader * r, size_t i, uint64_t * offset, uint32_t * time);
+
+/*!
+ * \brief Close the reader
+ *
+ * \param r The reader
+ */
+void sc_capture_reader_close(struct sc_capture_reader * r);
+
+#endif
+
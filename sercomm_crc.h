@@ -0,0 +1,189 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Built-in CRC hashes and single bit error correction
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM_CRC_H
+#define _SERCOMM_CRC_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*!
+ * \brief CRC-16/CCITT hash callback (poly 0x1021, init 0xFFFF, not reflected)
+ *
+ * Use it with hash_bytes = 2 in struct sercomm. The CRC is stored in host byte order.
+ */
+void sc_crc16_ccitt(unsigned char * hashptr, unsigned char * msg, int mlen);
+
+/*!
+ * \brief CRC-32 hash callback (IEEE 802.3: poly 0x04C11DB7 reflected, init and xorout 0xFFFFFFFF)
+ *
+ * Use it with hash_bytes = 4 in struct sercomm. The CRC is stored in host byte order.
+ */
+void sc_crc32(unsigned char * hashptr, unsigned char * msg, int mlen);
+
+/*!
+ * \brief Patch a built-in CRC after a change of the message
+ *
+ * The built-in CRCs are linear: the CRC of the changed message is the stored CRC xor the CRC
+ * of the difference, shifted by the bytes after it (without the initial and final values).
+ * The shift uses precomputed GF(2) operators for 2^k zero bytes, so the cost is
+ * O(len + log(tail)), instead of the rehash of the whole message.
+ *
+ * \param hash The hash callback: sc_crc16_ccitt or sc_crc32
+ * \param hashptr The stored CRC (the Hash field). It is updated
+ * \param old The old bytes of the changed span
+ * \param value The new bytes of the changed span
+ * \param len The length of the changed span
+ * \param tail The number of the hashed bytes after the span
+ *
+ * \return Zero on success, or -1 if the hash is not a built-in CRC
+ */
+int sc_crc_patch(void (* hash)(unsigned char * hashptr, unsigned char * msg, int mlen),
+        unsigned char * hashptr, const unsigned char * old, const unsigned char * value,
+        sc_size_t len, sc_size_t tail);
+
+/*!
+ * \brief Overwrite a span of an encoded message, and patch its Hash field
+ *
+ * Use it to rewrite the Command or the Timestamp field of a forwarded message without
+ * the rehash of the body. The Message length field could not be changed, and the messages
+ * with FEC parity are not supported.
+ *
+ * Example:
+ * \code
+ * uint32_t ts = now_ms();
+ * sc_crc_patch_frame(&sc, frame, len, sc.frame_start_bytes + sc.cmd_bytes, (unsigned char *)&ts, sizeof(ts));
+ * \endcode
+ *
+ * \param sc The main struct sercomm (the layout and the hash of the message)
+ * \param frame The encoded message
+ * \param flen The length of the encoded message
+ * \param off The offset of the span in the message
+ * \param value The new bytes of the span
+ * \param len The length of the span
+ *
+ * \return Zero on success, or -1 if the span is not in the hashed part or the hash is not a built-in CRC
+ */
+int sc_crc_patch_frame(struct sercomm * sc, unsigned char * frame, sc_size_t flen,
+        sc_size_t off, const unsigned char * value, sc_size_t len);
+
+/*! \brief Correct single bit errors */
+#define SC_CRCFIX_SINGLE					0x01
+/*! \brief Correct two adjacent bit errors in one byte */
+#define SC_CRCFIX_ADJACENT					0x02
+
+/*! \brief Syndrome table entry */
+struct sc_crcfix_entry {
+	/*! The syndrome (computed CRC xor received CRC) */
+	uint32_t		syndrome;
+	/*! The position of the error byte from the end of the hashed part, or the hash byte index */
+	uint16_t		byte;
+	/*! The error bits in the byte. Zero for an empty table entry */
+	uint8_t			bits;
+	/*! 1, if the error is in the Hash field itself; 2, if the syndrome belongs to more error patterns */
+	uint8_t			in_hash;
+};
+
+/*!
+ * \brief CRC syndrome based error correction
+ *
+ * The built-in CRCs are linear: the xor of the computed and the received CRC (the syndrome)
+ * depends only on the error pattern and its distance from the end of the message. Therefore
+ * one precomputed table serves all the message lengths up to max_len.
+ *
+ * If the hash verification fails, sc_get_message() looks up the syndrome. On a hit, it flips
+ * the bits, verifies the hash again, and processes the repaired message. Errors in the
+ * received Hash field are repaired the same way.
+ *
+ * Guards against false corrections:
+ * - Ambiguous syndromes (more than one error pattern) are never corrected.
+ * - Messages longer than guard_len (the hashed part) are not corrected. With longer
+ *   messages a multi-bit error more likely aliases to a single bit syndrome. For CRC-16/CCITT
+ *   the Hamming distance is 4 up to 4095 bytes, i.e., a 3-bit error is always detected.
+ * - A repair, which changes the Message length field, is rejected. Note: a wrong length gives
+ *   a random syndrome, which hits the table with the probability of (used entries / 2^16)
+ *   with CRC-16. Use CRC-32 or the header parity of sercomm_fec.h on noisy lines.
+ *
+ * The table is given by the caller. Its size should be a power of two, at least twice
+ * the number of patterns: 8 * max_len (single), 7 * max_len (adjacent), plus the patterns
+ * of the Hash field.
+ *
+ * Example:
+ * \code
+ * static struct sc_crcfix_entry fix_table[4096];
+ * static struct sercomm_crcfix fix = {
+ *     .table = fix_table, .table_size = 4096, .max_len = 128, .guard_len = 128,
+ *     .flags = SC_CRCFIX_SINGLE,
+ * };
+ *
+ * sc.hash = sc_crc16_ccitt;
+ * sc.hash_bytes = 2;
+ * sc_crcfix_init(&fix, sc_crc16_ccitt);
+ * sc.crcfix = &fix;
+ * \endcode
+ */
+struct sercomm_crcfix {
+	/*! Syndrome table */
+	struct sc_crcfix_entry * table;
+	/*! The number of the table entries (power of two) */
+	uint32_t		table_size;
+	/*! The maximal length of the hashed part covered by the table */
+	sc_size_t		max_len;
+	/*! The maximal length of the hashed part to correct (false correction guard) */
+	sc_size_t		guard_len;
+	/*! SC_CRCFIX_SINGLE and/or SC_CRCFIX_ADJACENT */
+	uint8_t			flags;
+	/*! Internal usage: The CRC width in bytes */
+	uint8_t			width;
+	/*! Internal usage: The hash callback */
+	void			(* hash)(unsigned char * hashptr, unsigned char * msg, int mlen);
+	/*!
+	 * Repair callback, set by sc_crcfix_init(). Arguments: the computed and the received hash,
+	 * the hashed part and its length. It returns zero, if the message is repaired.
+	 */
+	int				(* repair)(struct sercomm_crcfix * fix, unsigned char * computed,
+							unsigned char * received, unsigned char * msg, sc_size_t mlen);
+	/*! Statistics: The number of repaired messages */
+	uint32_t		repaired;
+	/*! Statistics: The number of repaired Hash fields */
+	uint32_t		repaired_hash;
+	/*! Statistics: The number of failed repairs (unknown syndrome, guard, or verification) */
+	uint32_t		rejected;
+};
+
+/*!
+ * \brief Build the syndrome table
+ *
+ * \param fix The correction configuration
+ * \param hash The hash callback of struct sercomm: sc_crc16_ccitt or sc_crc32
+ *
+ * \return Zero on success, or -1 if the hash is not a built-in CRC or the table is too small
+ */
+int sc_crcfix_init(struct sercomm_crcfix * fix,
+        void (* hash)(unsigned char * hashptr, unsigned char * msg, int mlen));
+
+#endif
+
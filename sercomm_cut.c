@@ -0,0 +1,165 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Cut-through forwarding
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <string.h>
+
+#include "sercomm_cut.h"
+
+int sc_cut_init(struct sc_cut * cut, struct sercomm * sc)
+{
+    if (sc->fec != NULL || sc->hash_bytes + sc->comm_ctrl_bytes > SC_CUT_MAX_TRAILER)
+        return -1;
+    cut->sc = sc;
+    cut->port = -1;
+    cut->out_len = 0;
+    sc->frame = sc_cut_frame;
+    sc->priv = cut;
+    return 0;
+}
+
+static void cut_flush(struct sc_cut * cut)
+{
+    if (cut->out_len > 0 && cut->port >= 0)
+        cut->write(cut, cut->port, cut->out, cut->out_len);
+    cut->out_len = 0;
+}
+
+static void cut_emit(struct sc_cut * cut, const unsigned char * data, sc_size_t len)
+{
+    sc_size_t n;
+
+    while (len > 0) {
+        if (cut->out_len == SC_CUT_OUT_SIZE)
+            cut_flush(cut);
+        n = SC_CUT_OUT_SIZE - cut->out_len;
+        if (n > len)
+            n = len;
+        memcpy(cut->out + cut->out_len, data, n);
+        cut->out_len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static uint32_t cut_field(const unsigned char * p, uint8_t len)
+{
+    uint16_t v16;
+    uint32_t v32;
+
+    switch (len) {
+        case 1:
+            return *p;
+        case 2:
+            memcpy(&v16, p, sizeof(v16));
+            return v16;
+        case 4:
+            memcpy(&v32, p, sizeof(v32));
+            return v32;
+    }
+    return 0;
+}
+
+/* The ingress message is cut: pad it, and make its hash wrong */
+static void cut_abort(struct sc_cut * cut)
+{
+    struct sercomm * sc = cut->sc;
+    unsigned char * buf = sc->buffer;
+
+    //The buffer still has the received bytes: complete the body with zeros
+    if (cut->count < cut->trailer) {
+        memset(&buf[cut->count], 0, cut->trailer - cut->count);
+        cut_emit(cut, &buf[cut->count], cut->trailer - cut->count);
+    }
+    memset(cut->hold, 0, sizeof(cut->hold));
+    if (sc->hash != NULL && sc->hash_bytes > 0) {
+        sc->hash(cut->hold, &buf[sc->frame_start_bytes], cut->trailer - sc->frame_start_bytes);
+        cut->hold[0] ^= 0xFF;
+    }
+    cut_emit(cut, cut->hold, cut->total - cut->trailer);
+    cut->aborted++;
+}
+
+void sc_cut_feed(struct sc_cut * cut, struct sercomm_msg * sm, const unsigned char * data, sc_size_t len)
+{
+    struct sercomm * sc = cut->sc;
+    sc_size_t i, sum1 = sc->frame_start_bytes + sc->cmd_bytes + sc->ts_bytes + sc->len_bytes;
+    int port;
+
+    for (i = 0; i < len; i++) {
+        sc_get_message(sc, sm, data[i]);
+
+        if (cut->port < 0) {
+            //A new validated header
+            if (!sc->header_done || sc->buffer_len != sum1 || sc->skip_len > 0)
+                continue;
+            port = cut->route(cut, cut_field(&sc->buffer[sc->frame_start_bytes], sc->cmd_bytes),
+                    cut_field(&sc->buffer[sc->frame_start_bytes + sc->cmd_bytes], sc->ts_bytes),
+                    sc->message_len);
+            if (port < 0)
+                continue;
+            cut->port = port;
+            cut->count = sum1;
+            cut->trailer = sum1 + sc->message_len;
+            cut->total = cut->trailer + sc->hash_bytes + sc->comm_ctrl_bytes;
+            cut->valid = 0;
+            cut_emit(cut, sc->buffer, sum1);
+            continue;
+        }
+
+        if (cut->count < cut->trailer)
+            cut_emit(cut, &data[i], 1);
+        else
+            cut->hold[cut->count - cut->trailer] = data[i];
+        cut->count++;
+        if (cut->count == cut->total) {
+            //The bytes are forwarded as they are: a wrong hash stays wrong
+            cut_emit(cut, cut->hold, cut->total - cut->trailer);
+            if (cut->valid)
+                cut->forwarded++;
+            else
+                cut->forwarded_bad++;
+        } else if (sc->buffer_len == cut->count) {
+            continue;
+        } else {
+            cut_abort(cut);
+        }
+        cut_flush(cut);
+        cut->port = -1;
+    }
+    cut_flush(cut);
+}
+
+void sc_cut_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_cut * cut = sc->priv;
+
+    if (cut->port >= 0) {
+        cut->valid = 1;
+        return;
+    }
+    cut->local++;
+    sc_dispatch(sm, f, cut->priv);
+}
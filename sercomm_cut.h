@@ -0,0 +1,142 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Cut-through forwarding
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_CUT_H
+#define _SERCOMM_CUT_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief The maximal length of the Hash and Comm. controll fields for cut-through */
+#define SC_CUT_MAX_TRAILER					64
+/*! \brief The size of the output staging buffer. It should fit in sc_size_t */
+#ifdef SERCOMM_USE_TINY_SC
+#define SC_CUT_OUT_SIZE						UINT8_MAX
+#else
+#define SC_CUT_OUT_SIZE						256
+#endif
+
+/*!
+ * \brief Cut-through forwarding
+ *
+ * It forwards the messages of an ingress parser to egress ports without waiting for the
+ * end of the message. When the header is validated (Frame start, length limits), the route
+ * callback selects the egress port by the command. The header is written to the port at
+ * once, and the body bytes are written as they arrive. Only the Hash and Comm. controll
+ * fields (the trailer) are held back until the end of the message, so the latency of a hop
+ * is about the header and trailer time instead of the message time.
+ *
+ * The bytes are forwarded as they are, so a message with a wrong hash fails the hash check
+ * of the next hop too. If the ingress message is cut (i.e., by the reset sequence), the rest
+ * is padded with zero bytes and a deliberately wrong hash, so the egress parser stays in sync
+ * and it drops the message.
+ *
+ * The messages, which are not routed, are processed by the command callbacks. The routed ones
+ * are not. The layout of the ports should be the same, and FEC is not supported (the parity
+ * would be corrected only at the end of the message).
+ *
+ * Example:
+ * \code
+ * static int route(struct sc_cut * cut, sc_cmd_t cmd, uint32_t ts, sc_size_t mlen)
+ * {
+ *     return cmd >= 0x20 && cmd < 0x30 ? PORT_DEVICES : -1;
+ * }
+ * static struct sc_cut cut = { .route = route, .write = port_write };
+ *
+ * sc_cut_init(&cut, &sc);
+ * n = read(fd, buf, sizeof(buf));
+ * sc_cut_feed(&cut, sms, buf, n);
+ * \endcode
+ */
+struct sc_cut {
+	/*! The ingress parser */
+	struct sercomm * sc;
+	/*! Last priv argument of the command callbacks */
+	void *			priv;
+	/*! Route callback: the egress port of a validated header, or -1 to process it locally */
+	int				(* route)(struct sc_cut * cut, sc_cmd_t cmd, uint32_t ts, sc_size_t mlen);
+	/*! Write callback of the egress ports */
+	void			(* write)(struct sc_cut * cut, int port, const unsigned char * data, sc_size_t len);
+	/*! Internal usage: The egress port of the forwarded message, or -1 */
+	int				port;
+	/*! Internal usage: The number of the received bytes of the forwarded message */
+	sc_size_t		count;
+	/*! Internal usage: The offset of the trailer */
+	sc_size_t		trailer;
+	/*! Internal usage: The length of the forwarded message */
+	sc_size_t		total;
+	/*! Internal usage: The message passed the hash check */
+	uint8_t			valid;
+	/*! Internal usage: The held back trailer */
+	unsigned char	hold[SC_CUT_MAX_TRAILER];
+	/*! Internal usage: The output staging buffer */
+	unsigned char	out[SC_CUT_OUT_SIZE];
+	/*! Internal usage: The number of the staged bytes */
+	sc_size_t		out_len;
+	/*! Statistics: The number of the forwarded valid messages */
+	uint32_t		forwarded;
+	/*! Statistics: The number of the forwarded messages with wrong hash */
+	uint32_t		forwarded_bad;
+	/*! Statistics: The number of the cut messages (padded and invalidated) */
+	uint32_t		aborted;
+	/*! Statistics: The number of the locally processed messages */
+	uint32_t		local;
+};
+
+/*!
+ * \brief Initialize the cut-through forwarding
+ *
+ * It sets the frame callback and the priv field of sc.
+ *
+ * \param cut The cut-through forwarding
+ * \param sc The ingress parser
+ *
+ * \return Zero on success, or -1 if the layout is not supported
+ */
+int sc_cut_init(struct sc_cut * cut, struct sercomm * sc);
+
+/*!
+ * \brief Parse and forward the received bytes
+ *
+ * The forwarded bytes are written at the end of the call, or when the staging buffer is full.
+ *
+ * \param cut The cut-through forwarding
+ * \param sm The struct sercomm_msg array of the local messages
+ * \param data The received bytes
+ * \param len The number of the received bytes
+ */
+void sc_cut_feed(struct sc_cut * cut, struct sercomm_msg * sm, const unsigned char * data, sc_size_t len);
+
+/*!
+ * \brief Frame callback of the cut-through forwarding
+ *
+ * sc_cut_init() sets it in the ingress parser.
+ */
+void sc_cut_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+
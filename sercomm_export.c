@@ -0,0 +1,396 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Columnar export of captures
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "sercomm_export.h"
+#include "sercomm_capture.h"
+#include "sercomm_fec.h"
+#include "sercomm_crc.h"
+
+#define EXPORT_READ_SIZE    65536
+#define EXPORT_PATH_MAX     4096
+/* The number of the chunks per thread, for the balance */
+#define EXPORT_CHUNKS       4
+
+/* Column builder of one command */
+struct export_builder {
+    sc_cmd_t            cmd;
+    uint32_t            rows;
+    uint32_t *          ts;
+    uint32_t *          len;
+    uint32_t *          cctrl;
+    uint32_t *          offsets;
+    unsigned char *     body;
+    uint32_t            body_bytes;
+    uint32_t            body_size;
+    FILE *              file;
+};
+
+struct export_ctx;
+
+/* The state of a thread */
+struct export_worker {
+    struct export_ctx * ctx;
+    struct export_builder * b;
+    uint32_t            nb;
+    uint32_t            last;           /* The builder of the last message */
+    uint32_t            chunk;
+    int                 error;
+    uint64_t            frames;
+    uint64_t            batches;
+    uint32_t            files;
+};
+
+struct export_ctx {
+    struct sc_capture_reader * r;
+    const char *        dir;
+    const struct sercomm * layout;
+    uint32_t            batch_rows;
+    uint64_t *          bounds;         /* nchunks + 1 offsets */
+    uint32_t            nchunks;
+    uint32_t            next;           /* The next chunk to parse */
+};
+
+static size_t export_pad(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+static int export_column(FILE * f, const void * p, size_t n)
+{
+    static const unsigned char zero[8];
+
+    if (n > 0 && fwrite(p, 1, n, f) != n)
+        return -1;
+    if (export_pad(n) != n && fwrite(zero, 1, export_pad(n) - n, f) != export_pad(n) - n)
+        return -1;
+    return 0;
+}
+
+static int export_batch(struct export_worker * w, struct export_builder * b)
+{
+    char path[EXPORT_PATH_MAX];
+    struct sc_export_batch h;
+    size_t col = b->rows * sizeof(uint32_t);
+
+    if (b->rows == 0)
+        return 0;
+    if (b->file == NULL) {
+        snprintf(path, sizeof(path), "%s/cmd%u-%u.scx", w->ctx->dir, (unsigned int)b->cmd, w->chunk);
+        b->file = fopen(path, "wb");
+        if (b->file == NULL)
+            return -1;
+        w->files++;
+    }
+    h.magic = SC_EXPORT_MAGIC;
+    h.cmd = b->cmd;
+    h.rows = b->rows;
+    h.body_bytes = b->body_bytes;
+    if (fwrite(&h, sizeof(h), 1, b->file) != 1 ||
+            export_column(b->file, b->ts, col) < 0 ||
+            export_column(b->file, b->len, col) < 0 ||
+            export_column(b->file, b->cctrl, col) < 0 ||
+            export_column(b->file, b->offsets, col + sizeof(uint32_t)) < 0 ||
+            export_column(b->file, b->body, b->body_bytes) < 0)
+        return -1;
+    w->batches++;
+    b->rows = 0;
+    b->body_bytes = 0;
+    return 0;
+}
+
+static struct export_builder * export_builder(struct export_worker * w, sc_cmd_t cmd)
+{
+    struct export_builder * b;
+    uint32_t rows = w->ctx->batch_rows, i;
+
+    if (w->last < w->nb && w->b[w->last].cmd == cmd)
+        return &w->b[w->last];
+    for (i = 0; i < w->nb; i++) {
+        if (w->b[i].cmd == cmd) {
+            w->last = i;
+            return &w->b[i];
+        }
+    }
+    b = realloc(w->b, (w->nb + 1) * sizeof(*b));
+    if (b == NULL)
+        return NULL;
+    w->b = b;
+    b = &w->b[w->nb];
+    memset(b, 0, sizeof(*b));
+    b->cmd = cmd;
+    //The fixed width columns are allocated for a full batch at once
+    b->ts = malloc(rows * sizeof(uint32_t));
+    b->len = malloc(rows * sizeof(uint32_t));
+    b->cctrl = malloc(rows * sizeof(uint32_t));
+    b->offsets = malloc((rows + 1) * sizeof(uint32_t));
+    if (b->ts == NULL || b->len == NULL || b->cctrl == NULL || b->offsets == NULL) {
+        free(b->ts);
+        free(b->len);
+        free(b->cctrl);
+        free(b->offsets);
+        return NULL;
+    }
+    b->offsets[0] = 0;
+    w->last = w->nb++;
+    return b;
+}
+
+static void export_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct export_worker * w = sc->priv;
+    struct export_builder * b;
+    unsigned char * body;
+    uint32_t size;
+
+    (void)sm;
+    //After a failed batch write the columns are full: stop storing
+    if (w->error)
+        return;
+    b = export_builder(w, f->cmd);
+    if (b == NULL) {
+        w->error = -1;
+        return;
+    }
+    if (b->body_bytes + f->mlen > b->body_size) {
+        size = b->body_size ? b->body_size : 4096;
+        while (size < b->body_bytes + f->mlen)
+            size *= 2;
+        body = realloc(b->body, size);
+        if (body == NULL) {
+            w->error = -1;
+            return;
+        }
+        b->body = body;
+        b->body_size = size;
+    }
+    b->ts[b->rows] = sc_frame_ts(sc, f);
+    b->len[b->rows] = f->mlen;
+    b->cctrl[b->rows] = f->cctrl;
+    if (f->mlen > 0)
+        memcpy(b->body + b->body_bytes, f->msg, f->mlen);
+    b->body_bytes += f->mlen;
+    b->rows++;
+    b->offsets[b->rows] = b->body_bytes;
+    w->frames++;
+    if (b->rows == w->ctx->batch_rows && export_batch(w, b) < 0)
+        w->error = -1;
+}
+
+/* Parse one chunk with a new parser */
+static int export_chunk(struct export_worker * w, struct sercomm * sc, unsigned char * buf,
+        struct sc_capture_cache * cache)
+{
+    const struct sercomm * layout = w->ctx->layout;
+    uint64_t off = w->ctx->bounds[w->chunk], end = w->ctx->bounds[w->chunk + 1];
+    struct sercomm_fec fec;
+    struct sercomm_crcfix fix;
+    unsigned char * rxbuf = sc->buffer;
+    long n, i;
+    uint32_t k;
+    int ret = 0;
+
+    memcpy(sc, layout, SIZEOF_SC(layout->frame_start_bytes));
+    sc->buffer = rxbuf;
+    sc->buffer_len = 0;
+    sc->message_len = 0;
+    sc->buffer_reset_bytes = 0;
+    sc->header_done = 0;
+    sc->skip_len = 0;
+    sc->filter_pending = 0;
+    sc->spec = NULL;
+    sc->spec_pending = NULL;
+    sc->stats = NULL;
+    sc->frame = export_frame;
+    sc->priv = w;
+    if (layout->fec != NULL) {
+        fec = *layout->fec;
+        sc->fec = &fec;
+    }
+    if (layout->crcfix != NULL) {
+        fix = *layout->crcfix;
+        sc->crcfix = &fix;
+    }
+
+    while (off < end && w->error == 0) {
+        n = sc_capture_pread_cached(w->ctx->r, cache, buf, end - off < EXPORT_READ_SIZE ? end - off : EXPORT_READ_SIZE, off);
+        if (n <= 0) {
+            if (n < 0)
+                ret = -1;
+            break;
+        }
+        for (i = 0; i < n && w->error == 0; i++)
+            sc_get_message(sc, NULL, buf[i]);
+        off += n;
+    }
+
+    for (k = 0; k < w->nb; k++) {
+        if (export_batch(w, &w->b[k]) < 0)
+            ret = -1;
+        if (w->b[k].file != NULL && fclose(w->b[k].file) != 0)
+            ret = -1;
+        w->b[k].file = NULL;
+    }
+    return w->error ? -1 : ret;
+}
+
+static void * export_main(void * arg)
+{
+    struct export_worker * w = arg;
+    struct sercomm * sc;
+    struct sc_capture_cache * cache;
+    unsigned char * buf;
+    uint32_t k;
+
+    sc = malloc(SIZEOF_SC(w->ctx->layout->frame_start_bytes));
+    buf = malloc(EXPORT_READ_SIZE);
+    //The chunks are read sequentially: a block is decompressed once per chunk
+    cache = sc_capture_cache_open(w->ctx->r);
+    if (sc != NULL)
+        sc->buffer = malloc(w->ctx->layout->buffer_size);
+    if (sc == NULL || buf == NULL || cache == NULL || sc->buffer == NULL) {
+        w->error = -1;
+        goto out;
+    }
+    for (;;) {
+        w->chunk = __atomic_fetch_add(&w->ctx->next, 1, __ATOMIC_RELAXED);
+        if (w->chunk >= w->ctx->nchunks)
+            break;
+        if (export_chunk(w, sc, buf, cache) < 0) {
+            w->error = -1;
+            break;
+        }
+    }
+
+out:
+    for (k = 0; k < w->nb; k++) {
+        free(w->b[k].ts);
+        free(w->b[k].len);
+        free(w->b[k].cctrl);
+        free(w->b[k].offsets);
+        free(w->b[k].body);
+    }
+    free(w->b);
+    if (sc != NULL)
+        free(sc->buffer);
+    free(sc);
+    free(buf);
+    sc_capture_cache_close(cache);
+    return NULL;
+}
+
+/* Split the capture at the sync points into about nchunks parts */
+static int export_split(struct export_ctx * ctx, uint64_t size, uint32_t nchunks)
+{
+    size_t nsync = sc_capture_sync_count(ctx->r), s = 0;
+    uint64_t off;
+    uint32_t k;
+
+    ctx->bounds = malloc((nchunks + 1) * sizeof(uint64_t));
+    if (ctx->bounds == NULL)
+        return -1;
+    ctx->bounds[0] = 0;
+    ctx->nchunks = 0;
+    for (k = 1; k < nchunks; k++) {
+        while (s < nsync && sc_capture_sync_point(ctx->r, s, &off, NULL) == 0 &&
+                off < size / nchunks * k)
+            s++;
+        if (s == nsync)
+            break;
+        sc_capture_sync_point(ctx->r, s, &off, NULL);
+        if (off > ctx->bounds[ctx->nchunks])
+            ctx->bounds[++ctx->nchunks] = off;
+    }
+    ctx->bounds[++ctx->nchunks] = size;
+    return 0;
+}
+
+int sc_export_capture(const char * capture, const char * dir, const struct sercomm * layout,
+        int threads, uint32_t batch_rows, struct sc_export_stats * st)
+{
+    struct export_ctx ctx;
+    struct export_worker * w;
+    pthread_t * th;
+    int i, started = 0, ret = 0;
+
+    if (batch_rows == 0)
+        return -1;
+    if (threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0)
+        threads = 1;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.dir = dir;
+    ctx.layout = layout;
+    ctx.batch_rows = batch_rows;
+    ctx.r = sc_capture_reader_open(capture);
+    if (ctx.r == NULL)
+        return -1;
+    w = calloc(threads, sizeof(*w));
+    th = calloc(threads, sizeof(*th));
+    if (w == NULL || th == NULL || export_split(&ctx, sc_capture_size(ctx.r), threads * EXPORT_CHUNKS) < 0) {
+        ret = -1;
+        goto out;
+    }
+
+    for (i = 0; i < threads; i++) {
+        w[i].ctx = &ctx;
+        if (pthread_create(&th[i], NULL, export_main, &w[i]) != 0) {
+            ret = -1;
+            break;
+        }
+        started++;
+    }
+    for (i = 0; i < started; i++)
+        pthread_join(th[i], NULL);
+
+    if (st != NULL)
+        memset(st, 0, sizeof(*st));
+    for (i = 0; i < started; i++) {
+        if (w[i].error)
+            ret = -1;
+        if (st != NULL) {
+            st->frames += w[i].frames;
+            st->batches += w[i].batches;
+            st->files += w[i].files;
+        }
+    }
+    if (st != NULL)
+        st->chunks = ctx.nchunks;
+
+out:
+    free(ctx.bounds);
+    free(th);
+    free(w);
+    sc_capture_reader_close(ctx.r);
+    return ret;
+}
@@ -0,0 +1,101 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Columnar export of captures
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_EXPORT_H
+#define _SERCOMM_EXPORT_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief The magic of a columnar batch ("SCX1") */
+#define SC_EXPORT_MAGIC						0x31584353
+
+/*!
+ * \brief Header of a columnar batch
+ *
+ * An export file is a sequence of batches. Each batch is this header and the columns in this
+ * order, every column is padded to 8 bytes (as the buffers of Apache Arrow):
+ * - ts: uint32_t[rows], the Timestamp field
+ * - len: uint32_t[rows], the length of the body
+ * - cctrl: uint32_t[rows], the comm. controll field
+ * - offsets: uint32_t[rows + 1], the offsets of the bodies in the body column
+ * - body: body_bytes bytes, the bodies after each other
+ *
+ * All the values are in host byte order.
+ */
+struct sc_export_batch {
+	/*! SC_EXPORT_MAGIC */
+	uint32_t		magic;
+	/*! The command value of the rows */
+	uint32_t		cmd;
+	/*! The number of the rows */
+	uint32_t		rows;
+	/*! The length of the body column */
+	uint32_t		body_bytes;
+};
+
+/*! \brief Export statistics */
+struct sc_export_stats {
+	/*! The number of the exported messages */
+	uint64_t		frames;
+	/*! The number of the written batches */
+	uint64_t		batches;
+	/*! The number of the capture chunks */
+	uint32_t		chunks;
+	/*! The number of the written files */
+	uint32_t		files;
+};
+
+/*!
+ * \brief Export a capture into per-command columnar files (POSIX host only)
+ *
+ * The capture (see sercomm_capture.h) is split into chunks at its sync points, and the chunks
+ * are parsed by a pool of threads. A chunk ends at the next sync point, where the original
+ * parser has just started a new frame, so the chunks give the same messages as one parse.
+ *
+ * Each thread appends the messages to per-command column builders, and it writes a batch,
+ * when a builder has batch_rows rows. The files are dir/cmd<cmd>-<chunk>.scx, so the order
+ * of the messages is the order of the chunk numbers and the batches.
+ *
+ * The parsers are copies of layout with their own buffer of layout->buffer_size bytes, and
+ * with their own copy of the FEC and CRC correction configuration. The frame callback of
+ * layout is not used.
+ *
+ * \param capture The capture file
+ * \param dir The output directory. It should exist
+ * \param layout The configuration of the parser
+ * \param threads The number of the threads. Zero to use one per online CPU
+ * \param batch_rows The maximum number of the rows per batch
+ * \param st Output: the statistics. NULL to omit
+ *
+ * \return Zero on success, or -1 if error occured
+ */
+int sc_export_capture(const char * capture, const char * dir, const struct sercomm * layout,
+        int threads, uint32_t batch_rows, struct sc_export_stats * st);
+
+#endif
+
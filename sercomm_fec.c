@@ -0,0 +1,368 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Reed-Solomon forward error correction
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "sercomm_fec.h"
+
+/* The number of interleaved codewords processed together */
+#define FEC_CHUNK           64
+/* GF(256) primitive polynomial: x^8 + x^4 + x^3 + x^2 + 1 */
+#define FEC_PRIM_POLY       0x11D
+
+static uint8_t gf_exp[512];
+static uint8_t gf_log[256];
+static uint8_t gf_ready;
+/* Generator polynomials, highest degree first: gen[nsym][0..nsym] */
+static uint8_t gf_gen[SERCOMM_FEC_MAX_NSYM + 1][SERCOMM_FEC_MAX_NSYM + 1];
+static uint8_t gf_gen_ready[SERCOMM_FEC_MAX_NSYM + 1];
+
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    if (a == 0 || b == 0)
+        return 0;
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+static uint8_t gf_div(uint8_t a, uint8_t b)
+{
+    if (a == 0)
+        return 0;
+    return gf_exp[gf_log[a] + 255 - gf_log[b]];
+}
+
+static void gf_init(void)
+{
+    unsigned int i, x = 1;
+
+    for (i = 0; i < 255; i++) {
+        gf_exp[i] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= FEC_PRIM_POLY;
+    }
+    for (i = 255; i < 512; i++)
+        gf_exp[i] = gf_exp[i - 255];
+    gf_ready = 1;
+}
+
+/* g(x) = (x + a^0)(x + a^1)...(x + a^(nsym-1)) */
+static void gf_gen_init(uint8_t nsym)
+{
+    uint8_t * g = gf_gen[nsym];
+    uint8_t i, j;
+
+    memset(g, 0, nsym + 1);
+    g[0] = 1;
+    for (i = 0; i < nsym; i++) {
+        for (j = i + 1; j > 0; j--)
+            g[j] ^= gf_mul(g[j - 1], gf_exp[i]);
+    }
+    gf_gen_ready[nsym] = 1;
+}
+
+/*
+ * dst[i] = a[i] ^ b[i] * c, or dst[i] = b[i] * c if a is NULL.
+ * The product is looked up in two 16 entries tables by the low and the high nibble.
+ */
+static void gf_mul_xor(unsigned char * dst, const unsigned char * a, const unsigned char * b,
+        uint8_t c, unsigned int n)
+{
+    uint8_t lo[16], hi[16];
+    unsigned int i = 0;
+
+    for (i = 0; i < 16; i++) {
+        lo[i] = gf_mul(c, (uint8_t)i);
+        hi[i] = gf_mul(c, (uint8_t)(i << 4));
+    }
+    i = 0;
+
+#if defined(__AVX2__)
+    {
+        __m256i tl = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)lo));
+        __m256i th = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)hi));
+        __m256i m = _mm256_set1_epi8(0x0F), v, p;
+
+        for (; i + 32 <= n; i += 32) {
+            v = _mm256_loadu_si256((const __m256i *)&b[i]);
+            p = _mm256_xor_si256(_mm256_shuffle_epi8(tl, _mm256_and_si256(v, m)),
+                    _mm256_shuffle_epi8(th, _mm256_and_si256(_mm256_srli_epi64(v, 4), m)));
+            if (a != NULL)
+                p = _mm256_xor_si256(p, _mm256_loadu_si256((const __m256i *)&a[i]));
+            _mm256_storeu_si256((__m256i *)&dst[i], p);
+        }
+    }
+#elif defined(__SSSE3__)
+    {
+        __m128i tl = _mm_loadu_si128((const __m128i *)lo);
+        __m128i th = _mm_loadu_si128((const __m128i *)hi);
+        __m128i m = _mm_set1_epi8(0x0F), v, p;
+
+        for (; i + 16 <= n; i += 16) {
+            v = _mm_loadu_si128((const __m128i *)&b[i]);
+            p = _mm_xor_si128(_mm_shuffle_epi8(tl, _mm_and_si128(v, m)),
+                    _mm_shuffle_epi8(th, _mm_and_si128(_mm_srli_epi64(v, 4), m)));
+            if (a != NULL)
+                p = _mm_xor_si128(p, _mm_loadu_si128((const __m128i *)&a[i]));
+            _mm_storeu_si128((__m128i *)&dst[i], p);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    {
+        uint8x16_t tl = vld1q_u8(lo), th = vld1q_u8(hi);
+        uint8x16_t m = vdupq_n_u8(0x0F), v, p;
+
+        for (; i + 16 <= n; i += 16) {
+            v = vld1q_u8(&b[i]);
+            p = veorq_u8(vqtbl1q_u8(tl, vandq_u8(v, m)), vqtbl1q_u8(th, vshrq_n_u8(v, 4)));
+            if (a != NULL)
+                p = veorq_u8(p, vld1q_u8(&a[i]));
+            vst1q_u8(&dst[i], p);
+        }
+    }
+#endif
+
+    for (; i < n; i++)
+        dst[i] = (a != NULL ? a[i] : 0) ^ lo[b[i] & 0x0F] ^ hi[b[i] >> 4];
+}
+
+/* Row r of the interleaved codewords j0 .. j0 + w - 1, zero padded after the end of the data */
+static const unsigned char * fec_row(const unsigned char * data, sc_size_t len, sc_size_t c,
+        sc_size_t r, sc_size_t j0, unsigned int w, unsigned char * tmp)
+{
+    sc_size_t at = r * c + j0;
+
+    if (at + w <= len)
+        return &data[at];
+    memset(tmp, 0, w);
+    if (at < len)
+        memcpy(tmp, &data[at], len - at);
+    return tmp;
+}
+
+static void fec_encode(struct sercomm_fec * fec, unsigned char * data, sc_size_t len,
+        uint8_t nsym, unsigned char * parity)
+{
+    unsigned char fb[FEC_CHUNK], tmp[FEC_CHUNK];
+    const unsigned char * row;
+    const uint8_t * g = gf_gen[nsym];
+    sc_size_t c, rows, r, j0;
+    unsigned int w, i;
+
+    if (len == 0 || nsym == 0)
+        return;
+    c = (len + fec->k - 1) / fec->k;
+    rows = (len + c - 1) / c;
+    memset(parity, 0, (sc_size_t)nsym * c);
+
+    //Parity registers of the codewords: P[i] = parity[i * c .. i * c + c - 1]
+    for (j0 = 0; j0 < c; j0 += FEC_CHUNK) {
+        w = c - j0 < FEC_CHUNK ? (unsigned int)(c - j0) : FEC_CHUNK;
+        for (r = 0; r < rows; r++) {
+            row = fec_row(data, len, c, r, j0, w, tmp);
+            for (i = 0; i < w; i++)
+                fb[i] = row[i] ^ parity[j0 + i];
+            for (i = 0; i + 1 < nsym; i++)
+                gf_mul_xor(&parity[i * c + j0], &parity[(i + 1) * c + j0], fb, g[i + 1], w);
+            gf_mul_xor(&parity[(nsym - 1) * c + j0], NULL, fb, g[nsym], w);
+        }
+    }
+}
+
+/*
+ * Correct one codeword from its syndromes (Berlekamp-Massey, Chien search, Forney).
+ * n is the codeword length; the positions are counted from the first (highest degree) symbol.
+ */
+static int rs_correct(const uint8_t * s, uint8_t nsym, unsigned int n, uint8_t * pos, uint8_t * val)
+{
+    uint8_t C[SERCOMM_FEC_MAX_NSYM + 1], B[SERCOMM_FEC_MAX_NSYM + 1], T[SERCOMM_FEC_MAX_NSYM + 1];
+    uint8_t omega[SERCOMM_FEC_MAX_NSYM], d, b = 1, coef, x, xinv, num, den;
+    unsigned int L = 0, m = 1, i, j, k, e, nerr = 0;
+
+    memset(C, 0, sizeof(C));
+    memset(B, 0, sizeof(B));
+    C[0] = B[0] = 1;
+
+    for (k = 0; k < nsym; k++) {
+        d = s[k];
+        for (i = 1; i <= L; i++)
+            d ^= gf_mul(C[i], s[k - i]);
+        if (d == 0) {
+            m++;
+            continue;
+        }
+        coef = gf_div(d, b);
+        if (2 * L <= k) {
+            memcpy(T, C, sizeof(C));
+            for (i = 0; i + m <= nsym; i++)
+                C[i + m] ^= gf_mul(coef, B[i]);
+            L = k + 1 - L;
+            memcpy(B, T, sizeof(B));
+            b = d;
+            m = 1;
+        } else {
+            for (i = 0; i + m <= nsym; i++)
+                C[i + m] ^= gf_mul(coef, B[i]);
+            m++;
+        }
+    }
+    if (L == 0 || 2 * L > nsym)
+        return -1;
+
+    //Omega(x) = S(x) * Lambda(x) mod x^nsym
+    for (i = 0; i < nsym; i++) {
+        omega[i] = 0;
+        for (j = 0; j <= i && j <= L; j++)
+            omega[i] ^= gf_mul(C[j], s[i - j]);
+    }
+
+    for (e = 0; e < n; e++) {
+        //Is X^-1 = a^-e a root of Lambda?
+        xinv = gf_exp[(255 - e) % 255];
+        d = 0;
+        for (i = L + 1; i-- > 0; )
+            d = gf_mul(d, xinv) ^ C[i];
+        if (d != 0)
+            continue;
+        if (nerr >= L)
+            return -1;
+
+        //Forney: e = X * Omega(X^-1) / Lambda'(X^-1)
+        x = gf_exp[e % 255];
+        num = 0;
+        for (i = nsym; i-- > 0; )
+            num = gf_mul(num, xinv) ^ omega[i];
+        den = 0;
+        for (i = 1; i <= L; i += 2)
+            den ^= gf_mul(C[i], gf_exp[(gf_log[xinv] * (i - 1)) % 255]);
+        if (den == 0)
+            return -1;
+        pos[nerr] = (uint8_t)(n - 1 - e);
+        val[nerr] = gf_mul(x, gf_div(num, den));
+        nerr++;
+    }
+
+    return nerr == L ? (int)nerr : -1;
+}
+
+static int fec_decode(struct sercomm_fec * fec, unsigned char * data, sc_size_t len,
+        uint8_t nsym, unsigned char * parity)
+{
+    unsigned char S[SERCOMM_FEC_MAX_NSYM][FEC_CHUNK], tmp[FEC_CHUNK];
+    uint8_t s[SERCOMM_FEC_MAX_NSYM], pos[SERCOMM_FEC_MAX_NSYM], val[SERCOMM_FEC_MAX_NSYM];
+    const unsigned char * row;
+    sc_size_t c, rows, r, j0, at;
+    unsigned int w, i, j, any;
+    int nerr, fixed = 0, failed = 0;
+
+    if (len == 0 || nsym == 0)
+        return 0;
+    c = (len + fec->k - 1) / fec->k;
+    rows = (len + c - 1) / c;
+
+    for (j0 = 0; j0 < c; j0 += FEC_CHUNK) {
+        w = c - j0 < FEC_CHUNK ? (unsigned int)(c - j0) : FEC_CHUNK;
+
+        //S[i] = r(a^i) for all the codewords of the chunk, by the Horner scheme
+        for (i = 0; i < nsym; i++)
+            memset(S[i], 0, w);
+        for (r = 0; r < rows + nsym; r++) {
+            if (r < rows)
+                row = fec_row(data, len, c, r, j0, w, tmp);
+            else
+                row = &parity[(r - rows) * c + j0];
+            for (i = 0; i < nsym; i++)
+                gf_mul_xor(S[i], row, S[i], gf_exp[i], w);
+        }
+
+        for (j = 0; j < w; j++) {
+            any = 0;
+            for (i = 0; i < nsym; i++) {
+                s[i] = S[i][j];
+                any |= s[i];
+            }
+            if (!any)
+                continue;
+            nerr = rs_correct(s, nsym, (unsigned int)(rows + nsym), pos, val);
+            for (i = 0; nerr > 0 && i < (unsigned int)nerr; i++) {
+                if (pos[i] >= rows)
+                    continue;
+                at = pos[i] * c + j0 + j;
+                if (at >= len)
+                    nerr = -1;         //An error in the zero padding: it is a false correction
+            }
+            if (nerr < 0) {
+                failed++;
+                continue;
+            }
+            for (i = 0; i < (unsigned int)nerr; i++) {
+                if (pos[i] < rows)
+                    data[pos[i] * c + j0 + j] ^= val[i];
+                else
+                    parity[(pos[i] - rows) * c + j0 + j] ^= val[i];
+            }
+            fixed += nerr;
+            fec->corrected_blocks++;
+        }
+    }
+
+    fec->corrected += fixed;
+    if (failed > 0) {
+        fec->failed_blocks += failed;
+        return -1;
+    }
+    return fixed;
+}
+
+int sc_fec_init(struct sercomm_fec * fec)
+{
+    if (fec->nsym == 0 || fec->nsym > SERCOMM_FEC_MAX_NSYM || (fec->nsym & 1))
+        return -1;
+    if (fec->nsym_hdr > SERCOMM_FEC_MAX_NSYM || (fec->nsym_hdr & 1))
+        return -1;
+    if (fec->k == 0 || fec->k + fec->nsym > 255 || fec->k + fec->nsym_hdr > 255)
+        return -1;
+
+    if (!gf_ready)
+        gf_init();
+    if (!gf_gen_ready[fec->nsym])
+        gf_gen_init(fec->nsym);
+    if (fec->nsym_hdr > 0 && !gf_gen_ready[fec->nsym_hdr])
+        gf_gen_init(fec->nsym_hdr);
+
+    fec->encode = fec_encode;
+    fec->decode = fec_decode;
+    return 0;
+}
+
@@ -0,0 +1,115 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Reed-Solomon forward error correction
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM_FEC_H
+#define _SERCOMM_FEC_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief The maximum number of parity symbols per codeword */
+#define SERCOMM_FEC_MAX_NSYM				32
+
+/*!
+ * \brief Reed-Solomon FEC configuration
+ *
+ * If the fec field of struct sercomm is set, sc_make_message() adds Reed-Solomon parity
+ * over GF(256) to the framed message, and sc_get_message() corrects the errors before the
+ * validation of the header and before the hash verification.
+ *
+ * <b>Message format with FEC:</b>
+ * \code
+ * +-------------+--------+---------------+------------------------------+-------------+
+ * |             |        |               |                              |             |
+ * | Frame start | Header | Header parity | Body, Hash, Comm. controll   | Body parity |
+ * |             |        |               |                              |             |
+ * +-------------+--------+---------------+------------------------------+-------------+
+ * \endcode
+ * - Header: the Command, Timestamp and Message length fields. It is one codeword with
+ *   nsym_hdr parity symbols, so the length is validated only after the correction.
+ * - Body parity: the body, hash and comm. controll part is split into ceil(len / k)
+ *   interleaved codewords (codeword j has the bytes j, j + c, j + 2c, ...), each with nsym
+ *   parity symbols. The interleaving spreads the error bursts of a serial line across the
+ *   codewords. Parity symbol i of codeword j is at i * c + j.
+ *
+ * Each codeword corrects up to nsym / 2 wrong bytes. The frame start is not protected.
+ * The buffer of struct sercomm should have room for the parity too.
+ *
+ * The parity is computed with a table lookup GF multiplication over the interleaved
+ * codewords, which uses SSSE3, AVX2 or NEON, if the compiler targets them.
+ *
+ * Example:
+ * \code
+ * static struct sercomm_fec fec = { .nsym_hdr = 4, .nsym = 8, .k = 64 };
+ *
+ * sc_fec_init(&fec);
+ * sc.fec = &fec;
+ * \endcode
+ */
+struct sercomm_fec {
+	/*! The number of parity symbols of the header codeword (even, zero to omit) */
+	uint8_t			nsym_hdr;
+	/*! The number of parity symbols per body codeword (even) */
+	uint8_t			nsym;
+	/*! The maximum number of data bytes per body codeword (k + nsym <= 255) */
+	uint8_t			k;
+	/*! Parity generator callback, set by sc_fec_init() */
+	void			(* encode)(struct sercomm_fec * fec, unsigned char * data, sc_size_t len,
+							uint8_t nsym, unsigned char * parity);
+	/*! Corrector callback, set by sc_fec_init(). It returns the number of corrected bytes, or -1 */
+	int				(* decode)(struct sercomm_fec * fec, unsigned char * data, sc_size_t len,
+							uint8_t nsym, unsigned char * parity);
+	/*! Statistics: The number of corrected bytes */
+	uint32_t		corrected;
+	/*! Statistics: The number of codewords with corrected bytes */
+	uint32_t		corrected_blocks;
+	/*! Statistics: The number of uncorrectable codewords */
+	uint32_t		failed_blocks;
+};
+
+/*!
+ * \brief The number of parity bytes of an FEC protected part
+ *
+ * \param k The maximum number of data bytes per codeword
+ * \param len The length of the protected part
+ * \param nsym The number of parity symbols per codeword
+ */
+#define SC_FEC_PARITY_LEN(k, len, nsym) \
+    ((len) == 0 || (nsym) == 0 ? 0 : (((len) + (k) - 1) / (k)) * (nsym))
+
+/*!
+ * \brief Initialize the FEC configuration
+ *
+ * It builds the GF(256) tables at the first call, and sets the callbacks.
+ *
+ * \param fec The FEC configuration
+ *
+ * \return Zero on success, or -1 if the configuration is invalid
+ */
+int sc_fec_init(struct sercomm_fec * fec);
+
+#endif
+
@@ -0,0 +1,364 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Header field filter expressions
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <string.h>
+#include <ctype.h>
+
+#include "sercomm_filter.h"
+
+struct fparser {
+    struct sercomm_filter * f;
+    const char *    expr;
+    const char *    p;
+    int             depth;
+    int             max_depth;
+    int             nest;           /* The nesting of the factors */
+    int             error;
+};
+
+static void fp_error(struct fparser * fp)
+{
+    if (fp->error == 0)
+        fp->error = (int)(fp->p - fp->expr) + 1;
+}
+
+static void fp_skip(struct fparser * fp)
+{
+    while (isspace((unsigned char)*fp->p))
+        fp->p++;
+}
+
+/* Match a punctuator */
+static int fp_punct(struct fparser * fp, const char * s)
+{
+    size_t n = strlen(s);
+
+    fp_skip(fp);
+    if (strncmp(fp->p, s, n))
+        return 0;
+    fp->p += n;
+    return 1;
+}
+
+/* Match a keyword (it should not be followed by an identifier character) */
+static int fp_word(struct fparser * fp, const char * s)
+{
+    size_t n = strlen(s);
+
+    fp_skip(fp);
+    if (strncmp(fp->p, s, n))
+        return 0;
+    if (isalnum((unsigned char)fp->p[n]) || fp->p[n] == '_')
+        return 0;
+    fp->p += n;
+    return 1;
+}
+
+static int fp_number(struct fparser * fp, uint32_t * val)
+{
+    uint32_t v = 0;
+    int base = 10, digits = 0, d;
+
+    fp_skip(fp);
+    if (fp->p[0] == '0' && (fp->p[1] == 'x' || fp->p[1] == 'X')) {
+        base = 16;
+        fp->p += 2;
+    }
+    for (;;) {
+        if (isdigit((unsigned char)*fp->p))
+            d = *fp->p - '0';
+        else if (base == 16 && isxdigit((unsigned char)*fp->p))
+            d = tolower((unsigned char)*fp->p) - 'a' + 10;
+        else
+            break;
+        if (v > (UINT32_MAX - d) / base) {
+            fp_error(fp);
+            return 0;
+        }
+        v = v * base + d;
+        fp->p++;
+        digits++;
+    }
+    if (digits == 0) {
+        fp_error(fp);
+        return 0;
+    }
+    *val = v;
+    return 1;
+}
+
+static struct sercomm_filter_insn * fp_emit(struct fparser * fp, uint8_t op, int push)
+{
+    struct sercomm_filter_insn * in;
+
+    if (fp->f->ninsn >= SERCOMM_FILTER_MAX_INSN) {
+        fp_error(fp);
+        return NULL;
+    }
+    fp->depth += push;
+    if (fp->depth > fp->max_depth)
+        fp->max_depth = fp->depth;
+    in = &fp->f->insn[fp->f->ninsn++];
+    memset(in, 0, sizeof(*in));
+    in->op = op;
+    return in;
+}
+
+static void fp_expr(struct fparser * fp);
+
+static void fp_pred(struct fparser * fp)
+{
+    static const char * const names[] = { "cmd", "ts", "len", "cctrl" };
+    static const struct { const char * s; uint8_t op; } cmps[] = {
+        { "==", SC_FOP_EQ }, { "!=", SC_FOP_NE },
+        { "<=", SC_FOP_LE }, { ">=", SC_FOP_GE },
+        { "<", SC_FOP_LT }, { ">", SC_FOP_GT },
+    };
+    struct sercomm_filter_insn * in;
+    uint32_t mask = UINT32_MAX, val;
+    uint8_t field, i;
+
+    for (field = 0; field < sizeof(names) / sizeof(names[0]); field++) {
+        if (fp_word(fp, names[field]))
+            break;
+    }
+    if (field == sizeof(names) / sizeof(names[0])) {
+        fp_error(fp);
+        return;
+    }
+    fp->f->fields |= 1 << field;
+
+    fp_skip(fp);
+    if (fp->p[0] == '&' && fp->p[1] != '&') {
+        fp->p++;
+        if (!fp_number(fp, &mask))
+            return;
+    }
+
+    for (i = 0; i < sizeof(cmps) / sizeof(cmps[0]); i++) {
+        if (fp_punct(fp, cmps[i].s))
+            break;
+    }
+    if (i < sizeof(cmps) / sizeof(cmps[0])) {
+        if (!fp_number(fp, &val))
+            return;
+        if ((in = fp_emit(fp, cmps[i].op, 1)) == NULL)
+            return;
+        in->arg = val;
+    } else if (fp_word(fp, "in")) {
+        if (!fp_punct(fp, "{")) {
+            fp_error(fp);
+            return;
+        }
+        if ((in = fp_emit(fp, SC_FOP_IN, 1)) == NULL)
+            return;
+        in->arg = fp->f->nconst;
+        do {
+            if (!fp_number(fp, &val))
+                return;
+            if (fp->f->nconst >= SERCOMM_FILTER_MAX_CONST) {
+                fp_error(fp);
+                return;
+            }
+            fp->f->consts[fp->f->nconst++] = val;
+            in->nconst++;
+        } while (fp_punct(fp, ","));
+        if (!fp_punct(fp, "}")) {
+            fp_error(fp);
+            return;
+        }
+    } else {
+        //Bare field or masked field: true, if it is non-zero
+        if ((in = fp_emit(fp, SC_FOP_NE, 1)) == NULL)
+            return;
+        in->arg = 0;
+    }
+    in->field = field;
+    in->mask = mask;
+}
+
+static void fp_factor(struct fparser * fp)
+{
+    int neg = 0;
+
+    //Bound the recursion of "!!!..." and "(((..."
+    if (fp->nest >= SERCOMM_FILTER_MAX_NEST) {
+        fp_error(fp);
+        return;
+    }
+    fp->nest++;
+    fp_skip(fp);
+    if (fp->p[0] == '!' && fp->p[1] != '=') {
+        fp->p++;
+        neg = 1;
+    } else if (fp_word(fp, "not")) {
+        neg = 1;
+    }
+
+    if (neg) {
+        fp_factor(fp);
+        fp_emit(fp, SC_FOP_NOT, 0);
+    } else if (fp_punct(fp, "(")) {
+        fp_expr(fp);
+        if (!fp_punct(fp, ")"))
+            fp_error(fp);
+    } else {
+        fp_pred(fp);
+    }
+    fp->nest--;
+}
+
+static void fp_term(struct fparser * fp)
+{
+    fp_factor(fp);
+    while (fp->error == 0 && (fp_word(fp, "and") || fp_punct(fp, "&&"))) {
+        fp_factor(fp);
+        fp_emit(fp, SC_FOP_AND, -1);
+    }
+}
+
+static void fp_expr(struct fparser * fp)
+{
+    fp_term(fp);
+    while (fp->error == 0 && (fp_word(fp, "or") || fp_punct(fp, "||"))) {
+        fp_term(fp);
+        fp_emit(fp, SC_FOP_OR, -1);
+    }
+}
+
+int sc_filter_compile(struct sercomm_filter * f, const char * expr)
+{
+    struct fparser fp;
+
+    memset(f, 0, sizeof(*f));
+    memset(&fp, 0, sizeof(fp));
+    fp.f = f;
+    fp.expr = expr;
+    fp.p = expr;
+
+    fp_skip(&fp);
+    if (*fp.p == '\0') {
+        fp_emit(&fp, SC_FOP_TRUE, 1);
+        return 0;
+    }
+    fp_expr(&fp);
+    fp_skip(&fp);
+    if (fp.error == 0 && *fp.p != '\0')
+        fp_error(&fp);
+    if (fp.error == 0 && fp.max_depth > SERCOMM_FILTER_MAX_DEPTH) {
+        fp.p = expr;
+        fp_error(&fp);
+    }
+    if (fp.error != 0)
+        memset(f, 0, sizeof(*f));
+    return fp.error;
+}
+
+static uint32_t filter_field(const struct sercomm_filter_insn * in, const uint32_t * fields)
+{
+    return fields[in->field] & in->mask;
+}
+
+int sc_filter_eval(const struct sercomm_filter * f, uint32_t cmd, uint32_t ts,
+        uint32_t len, uint32_t cctrl, int cctrl_known)
+{
+    const struct sercomm_filter_insn * in;
+    uint8_t stack[SERCOMM_FILTER_MAX_DEPTH];
+    uint32_t fields[4], v;
+    int sp = 0;
+    uint8_t i, j, a, b;
+
+    fields[SC_FILTER_CMD] = cmd;
+    fields[SC_FILTER_TS] = ts;
+    fields[SC_FILTER_LEN] = len;
+    fields[SC_FILTER_CCTRL] = cctrl;
+
+    for (i = 0; i < f->ninsn; i++) {
+        in = &f->insn[i];
+        if (in->op >= SC_FOP_EQ && in->op <= SC_FOP_IN &&
+                in->field == SC_FILTER_CCTRL && !cctrl_known) {
+            stack[sp++] = SC_FILTER_UNKNOWN;
+            continue;
+        }
+        switch (in->op) {
+            case SC_FOP_TRUE:
+                stack[sp++] = SC_FILTER_PASS;
+                break;
+            case SC_FOP_EQ:
+                stack[sp++] = filter_field(in, fields) == in->arg;
+                break;
+            case SC_FOP_NE:
+                stack[sp++] = filter_field(in, fields) != in->arg;
+                break;
+            case SC_FOP_LT:
+                stack[sp++] = filter_field(in, fields) < in->arg;
+                break;
+            case SC_FOP_LE:
+                stack[sp++] = filter_field(in, fields) <= in->arg;
+                break;
+            case SC_FOP_GT:
+                stack[sp++] = filter_field(in, fields) > in->arg;
+                break;
+            case SC_FOP_GE:
+                stack[sp++] = filter_field(in, fields) >= in->arg;
+                break;
+            case SC_FOP_IN:
+                v = filter_field(in, fields);
+                for (j = 0; j < in->nconst; j++) {
+                    if (f->consts[in->arg + j] == v)
+                        break;
+                }
+                stack[sp++] = j < in->nconst;
+                break;
+            case SC_FOP_AND:
+                b = stack[--sp];
+                a = stack[--sp];
+                if (a == SC_FILTER_FAIL || b == SC_FILTER_FAIL)
+                    stack[sp++] = SC_FILTER_FAIL;
+                else if (a == SC_FILTER_PASS && b == SC_FILTER_PASS)
+                    stack[sp++] = SC_FILTER_PASS;
+                else
+                    stack[sp++] = SC_FILTER_UNKNOWN;
+                break;
+            case SC_FOP_OR:
+                b = stack[--sp];
+                a = stack[--sp];
+                if (a == SC_FILTER_PASS || b == SC_FILTER_PASS)
+                    stack[sp++] = SC_FILTER_PASS;
+                else if (a == SC_FILTER_FAIL && b == SC_FILTER_FAIL)
+                    stack[sp++] = SC_FILTER_FAIL;
+                else
+                    stack[sp++] = SC_FILTER_UNKNOWN;
+                break;
+            case SC_FOP_NOT:
+                if (stack[sp - 1] != SC_FILTER_UNKNOWN)
+                    stack[sp - 1] = !stack[sp - 1];
+                break;
+        }
+    }
+
+    return sp > 0 ? stack[sp - 1] : SC_FILTER_PASS;
+}
+
@@ -0,0 +1,170 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Header field filter expressions
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM_FILTER_H
+#define _SERCOMM_FILTER_H
+
+#include <inttypes.h>
+
+/*! \brief The maximum number of instructions in a compiled filter */
+#define SERCOMM_FILTER_MAX_INSN				32
+/*! \brief The maximum number of set members (in {...}) in a compiled filter */
+#define SERCOMM_FILTER_MAX_CONST			32
+/*! \brief The maximum nesting of "not" and parentheses in a filter expression */
+#define SERCOMM_FILTER_MAX_NEST				32
+/*! \brief The maximum evaluation stack depth of a compiled filter */
+#define SERCOMM_FILTER_MAX_DEPTH			8
+
+/*! \brief Header fields which could be used in filter expressions */
+enum sercomm_filter_field {
+	SC_FILTER_CMD = 0,
+	SC_FILTER_TS,
+	SC_FILTER_LEN,
+	SC_FILTER_CCTRL,
+};
+
+/*! \brief Filter instruction opcodes */
+enum sercomm_filter_op {
+	/*! Push true (empty filter) */
+	SC_FOP_TRUE = 0,
+	/*! Push ((field & mask) == arg) */
+	SC_FOP_EQ,
+	/*! Push ((field & mask) != arg) */
+	SC_FOP_NE,
+	/*! Push ((field & mask) < arg) */
+	SC_FOP_LT,
+	/*! Push ((field & mask) <= arg) */
+	SC_FOP_LE,
+	/*! Push ((field & mask) > arg) */
+	SC_FOP_GT,
+	/*! Push ((field & mask) >= arg) */
+	SC_FOP_GE,
+	/*! Push ((field & mask) in consts[arg .. arg + nconst - 1]) */
+	SC_FOP_IN,
+	/*! Pop two, push their conjunction */
+	SC_FOP_AND,
+	/*! Pop two, push their disjunction */
+	SC_FOP_OR,
+	/*! Pop one, push its negation */
+	SC_FOP_NOT,
+};
+
+/*! \brief Filter evaluation results */
+enum sercomm_filter_result {
+	/*! The frame does not match */
+	SC_FILTER_FAIL = 0,
+	/*! The frame matches */
+	SC_FILTER_PASS = 1,
+	/*! The result depends on a field which is not received yet (cctrl) */
+	SC_FILTER_UNKNOWN = 2,
+};
+
+/*! \brief One filter instruction */
+struct sercomm_filter_insn {
+	/*! Opcode, see enum sercomm_filter_op */
+	uint8_t			op;
+	/*! Header field, see enum sercomm_filter_field */
+	uint8_t			field;
+	/*! The number of set members of SC_FOP_IN */
+	uint8_t			nconst;
+	/*! Mask applied to the field before the comparison */
+	uint32_t		mask;
+	/*! Comparison value, or index of the first set member of SC_FOP_IN */
+	uint32_t		arg;
+};
+
+/*!
+ * \brief Compiled filter expression
+ *
+ * A filter is compiled once (sc_filter_compile()) into a short postfix program, and
+ * it is evaluated by sc_get_message() as soon as the Sercomm header is complete.
+ * If a frame does not match the filter, the rest of the frame is skipped by its length
+ * without buffering, hashing or dispatching it.
+ *
+ * The Comm. controll field is received after the message body, so the predicates on
+ * cctrl are unknown at header time. If the result depends on them, the frame is buffered
+ * and the filter is evaluated again before the hash check.
+ *
+ * Example:
+ * \code
+ * static struct sercomm_filter flt;
+ *
+ * if (sc_filter_compile(&flt, "cmd in {0x21, 0x22} and cctrl & 0x4 or len > 64") != 0)
+ *     error();
+ * sc.filter = &flt;
+ * \endcode
+ */
+struct sercomm_filter {
+	/*! The number of instructions */
+	uint8_t			ninsn;
+	/*! The number of set members */
+	uint8_t			nconst;
+	/*! Bit mask of the used header fields (1 << enum sercomm_filter_field) */
+	uint8_t			fields;
+	/*! Program */
+	struct sercomm_filter_insn insn[SERCOMM_FILTER_MAX_INSN];
+	/*! Set members */
+	uint32_t		consts[SERCOMM_FILTER_MAX_CONST];
+};
+
+/*!
+ * \brief Compile a filter expression
+ *
+ * Grammar:
+ * \code
+ * expr   := term { ("or" | "||") term }
+ * term   := factor { ("and" | "&&") factor }
+ * factor := ("not" | "!") factor | "(" expr ")" | pred
+ * pred   := field [ "&" number ] [ cmpop number | "in" "{" number { "," number } "}" ]
+ * field  := "cmd" | "ts" | "len" | "cctrl"
+ * cmpop  := "==" | "!=" | "<" | "<=" | ">" | ">="
+ * \endcode
+ * Numbers are decimal, or hexadecimal with 0x prefix. A predicate without comparison
+ * is true if it is non-zero, i.e., "cctrl & 0x4". An empty expression matches everything.
+ *
+ * \param f The filter to compile into
+ * \param expr The filter expression
+ *
+ * \return Zero on success, or the position (starting from 1) of the error in expr
+ */
+int sc_filter_compile(struct sercomm_filter * f, const char * expr);
+
+/*!
+ * \brief Evaluate a compiled filter
+ *
+ * \param f The compiled filter
+ * \param cmd The value of the Command field
+ * \param ts The value of the Timestamp field
+ * \param len The value of the Message length field
+ * \param cctrl The value of the Comm. controll field
+ * \param cctrl_known Zero, if the Comm. controll field is not received yet
+ *
+ * \return SC_FILTER_PASS, SC_FILTER_FAIL or SC_FILTER_UNKNOWN
+ */
+int sc_filter_eval(const struct sercomm_filter * f, uint32_t cmd, uint32_t ts,
+        uint32_t len, uint32_t cctrl, int cctrl_known);
+
+#endif
+
@@ -0,0 +1,495 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Persistent transmit journal
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sercomm_journal.h"
+#include "sercomm_crc.h"
+
+#define JOURNAL_MAGIC       0x314A4353      /* "SCJ1" */
+/* The header page has two header slots, written alternately */
+#define JOURNAL_SLOT_SIZE   512
+#define JOURNAL_REC_PAD     0x01
+#define JOURNAL_REC_SIZE(len) \
+    ((sizeof(struct journal_rec) + (len) + 7) & ~(uint64_t)7)
+
+struct journal_hdr {
+    uint32_t            magic;
+    uint32_t            crc;            /* Of the rest of the header */
+    uint64_t            serial;         /* Incremented at each write: the larger slot is valid */
+    uint64_t            gen;
+    uint64_t            capacity;
+    uint64_t            head_off;
+    uint64_t            head_seq;
+};
+
+struct journal_rec {
+    uint32_t            crc;            /* Of the rest of the record with the frame */
+    uint32_t            len;
+    uint64_t            seq;
+    uint32_t            gen;
+    uint32_t            flags;
+};
+
+struct sc_journal {
+    int                 fd;
+    unsigned char *     map;
+    size_t              map_size;
+    size_t              page;
+    unsigned char *     ring;
+    uint64_t            capacity;
+    uint64_t            head_off;
+    uint64_t            head_seq;
+    uint64_t            tail_off;
+    uint64_t            tail_seq;
+    uint64_t            used;
+    uint64_t            gen;
+    uint64_t            serial;
+    int                 slot;           /* The slot of the last written header */
+    int                 hdr_dirty;
+    uint64_t            sync_off;       /* The first byte appended since the last commit */
+    uint64_t            dirty;          /* The number of bytes appended since the last commit */
+    uint64_t            durable_seq;
+    unsigned int        batch;
+    unsigned int        pending;
+    uint64_t            commits;
+    uint64_t            commit_errors;
+    uint64_t            recovered;
+};
+
+static uint32_t journal_crc(const void * p, size_t n)
+{
+    uint32_t crc;
+
+    sc_crc32((unsigned char *)&crc, (unsigned char *)p, (int)n);
+    return crc;
+}
+
+static struct journal_rec * journal_rec_at(struct sc_journal * j, uint64_t off)
+{
+    return (struct journal_rec *)(j->ring + off);
+}
+
+static void journal_rec_seal(struct journal_rec * r)
+{
+    r->crc = journal_crc(&r->len, sizeof(*r) - sizeof(r->crc) + r->len);
+}
+
+static int journal_hdr_valid(const struct journal_hdr * h)
+{
+    return h->magic == JOURNAL_MAGIC && h->crc == journal_crc(&h->serial, sizeof(*h) - 8);
+}
+
+static void journal_hdr_write(struct sc_journal * j)
+{
+    struct journal_hdr h;
+
+    h.magic = JOURNAL_MAGIC;
+    h.serial = ++j->serial;
+    h.gen = j->gen;
+    h.capacity = j->capacity;
+    h.head_off = j->head_off;
+    h.head_seq = j->head_seq;
+    h.crc = journal_crc(&h.serial, sizeof(h) - 8);
+    //The other slot: a torn write leaves the last valid header intact
+    j->slot ^= 1;
+    memcpy(j->map + j->slot * JOURNAL_SLOT_SIZE, &h, sizeof(h));
+    j->hdr_dirty = 1;
+}
+
+static int journal_sync(struct sc_journal * j, uint64_t off, uint64_t len)
+{
+    uint64_t start = (off / j->page) * j->page;
+    uint64_t end = off + len;
+
+    if (len == 0)
+        return 0;
+    end = (end + j->page - 1) / j->page * j->page;
+    return msync(j->ring + start, end - start, MS_SYNC);
+}
+
+int sc_journal_commit(struct sc_journal * j)
+{
+    uint64_t first;
+
+    if (j->dirty >= j->capacity) {
+        if (journal_sync(j, 0, j->capacity) < 0)
+            return -1;
+    } else if (j->sync_off + j->dirty <= j->capacity) {
+        if (journal_sync(j, j->sync_off, j->dirty) < 0)
+            return -1;
+    } else {
+        first = j->capacity - j->sync_off;
+        if (journal_sync(j, j->sync_off, first) < 0 || journal_sync(j, 0, j->dirty - first) < 0)
+            return -1;
+    }
+    //The records first, then the head, which refers to them
+    if (j->hdr_dirty) {
+        if (msync(j->map, j->page, MS_SYNC) < 0)
+            return -1;
+        j->hdr_dirty = 0;
+    }
+    j->sync_off = j->tail_off;
+    j->dirty = 0;
+    j->pending = 0;
+    j->durable_seq = j->tail_seq;
+    j->commits++;
+    return 0;
+}
+
+/*
+ * Validate the record at off. It returns the record, and the number of bytes it uses
+ * with the implicit wrap (a tail shorter than a record header), or NULL.
+ */
+static struct journal_rec * journal_scan_rec(struct sc_journal * j, uint64_t * off, uint64_t * size,
+        uint64_t seq, uint32_t mingen)
+{
+    struct journal_rec * r;
+    uint64_t skip = 0;
+
+    if (j->capacity - *off < sizeof(*r)) {
+        skip = j->capacity - *off;
+        *off = 0;
+    }
+    r = journal_rec_at(j, *off);
+    if (r->seq != seq || r->gen < mingen || r->len > j->capacity - *off - sizeof(*r))
+        return NULL;
+    if (r->crc != journal_crc(&r->len, sizeof(*r) - sizeof(r->crc) + r->len))
+        return NULL;
+    if (r->flags & JOURNAL_REC_PAD)
+        *size = skip + j->capacity - *off;
+    else
+        *size = skip + JOURNAL_REC_SIZE(r->len);
+    return r;
+}
+
+/* Follow the consistent records from the head */
+static void journal_recover(struct sc_journal * j)
+{
+    struct journal_rec * r;
+    uint64_t off = j->head_off, next, size;
+    uint32_t mingen = 0;
+
+    j->used = 0;
+    j->tail_seq = j->head_seq;
+    for (;;) {
+        next = off;
+        r = journal_scan_rec(j, &next, &size, j->tail_seq, mingen);
+        if (r == NULL || j->used + size > j->capacity)
+            break;
+        //A stale record of an older generation could follow a newer one
+        mingen = r->gen;
+        j->used += size;
+        if (r->flags & JOURNAL_REC_PAD) {
+            off = 0;
+            continue;
+        }
+        off = next + JOURNAL_REC_SIZE(r->len);
+        if (off == j->capacity)
+            off = 0;
+        j->tail_seq++;
+        j->recovered++;
+    }
+    if (j->used == 0)
+        off = j->head_off;
+    j->tail_off = off;
+}
+
+struct sc_journal * sc_journal_open(const char * path, size_t capacity, unsigned int batch)
+{
+    struct sc_journal * j;
+    struct journal_hdr h[2];
+    struct stat st;
+    int fresh = 0, s;
+
+    j = calloc(1, sizeof(*j));
+    if (j == NULL)
+        return NULL;
+    j->batch = batch;
+    j->page = (size_t)sysconf(_SC_PAGESIZE);
+    if (j->page < 2 * JOURNAL_SLOT_SIZE)
+        j->page = 2 * JOURNAL_SLOT_SIZE;
+    j->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (j->fd < 0)
+        goto error_free;
+    if (fstat(j->fd, &st) < 0)
+        goto error;
+
+    if (st.st_size == 0) {
+        j->capacity = (capacity + j->page - 1) / j->page * j->page;
+        if (j->capacity == 0 || ftruncate(j->fd, j->page + j->capacity) < 0 || fsync(j->fd) < 0)
+            goto error;
+        fresh = 1;
+    } else {
+        if (pread(j->fd, &h[0], sizeof(h[0]), 0) != sizeof(h[0]) ||
+                pread(j->fd, &h[1], sizeof(h[1]), JOURNAL_SLOT_SIZE) != sizeof(h[1]))
+            goto error;
+        if (!journal_hdr_valid(&h[0]))
+            s = 1;
+        else if (!journal_hdr_valid(&h[1]))
+            s = 0;
+        else
+            s = h[1].serial > h[0].serial;
+        if (!journal_hdr_valid(&h[s]) || h[s].capacity % j->page ||
+                (uint64_t)st.st_size < j->page + h[s].capacity || h[s].head_off >= h[s].capacity)
+            goto error;
+        j->capacity = h[s].capacity;
+        j->serial = h[s].serial;
+        j->gen = h[s].gen;
+        j->head_off = h[s].head_off;
+        j->head_seq = h[s].head_seq;
+        j->slot = s;
+    }
+
+    j->map_size = j->page + j->capacity;
+    j->map = mmap(NULL, j->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, j->fd, 0);
+    if (j->map == MAP_FAILED)
+        goto error;
+    j->ring = j->map + j->page;
+
+    if (fresh) {
+        j->head_seq = 1;
+        j->tail_seq = 1;
+        j->slot = 1;
+    } else {
+        journal_recover(j);
+    }
+    j->durable_seq = j->tail_seq;
+    j->sync_off = j->tail_off;
+    j->gen++;
+    journal_hdr_write(j);
+    if (sc_journal_commit(j) < 0)
+        goto error_unmap;
+    j->commits = 0;
+    return j;
+
+error_unmap:
+    munmap(j->map, j->map_size);
+error:
+    close(j->fd);
+error_free:
+    free(j);
+    return NULL;
+}
+
+/* Contiguous free space at the tail */
+static uint64_t journal_contig(struct sc_journal * j)
+{
+    if (j->used == j->capacity)
+        return 0;
+    if (j->used == 0 || j->tail_off >= j->head_off)
+        return j->capacity - j->tail_off;
+    return j->head_off - j->tail_off;
+}
+
+/* Contiguous free space at the beginning of the ring after a wrap */
+static uint64_t journal_wrapped(struct sc_journal * j)
+{
+    if (j->used == j->capacity || (j->used > 0 && j->tail_off < j->head_off))
+        return 0;
+    return j->head_off;
+}
+
+static void journal_wrap(struct sc_journal * j)
+{
+    struct journal_rec * r;
+    uint64_t rest = j->capacity - j->tail_off;
+
+    if (rest >= sizeof(*r)) {
+        r = journal_rec_at(j, j->tail_off);
+        r->len = 0;
+        r->seq = j->tail_seq;
+        r->gen = (uint32_t)j->gen;
+        r->flags = JOURNAL_REC_PAD;
+        journal_rec_seal(r);
+    }
+    j->used += rest;
+    j->dirty += rest;
+    j->tail_off = 0;
+}
+
+/* Find room for a record at the tail, wrap if needed */
+static struct journal_rec * journal_reserve(struct sc_journal * j, uint64_t size)
+{
+    if (size > journal_contig(j)) {
+        if (size > journal_wrapped(j))
+            return NULL;
+        journal_wrap(j);
+    }
+    return journal_rec_at(j, j->tail_off);
+}
+
+static uint64_t journal_finish(struct sc_journal * j, struct journal_rec * r, sc_size_t len)
+{
+    uint64_t size = JOURNAL_REC_SIZE(len), seq = j->tail_seq;
+
+    r->len = len;
+    r->seq = seq;
+    r->gen = (uint32_t)j->gen;
+    r->flags = 0;
+    journal_rec_seal(r);
+    j->tail_off += size;
+    if (j->tail_off == j->capacity)
+        j->tail_off = 0;
+    j->used += size;
+    j->dirty += size;
+    j->tail_seq++;
+    //The record is appended anyway: a failed commit is retried by the next one
+    if (j->batch > 0 && ++j->pending >= j->batch && sc_journal_commit(j) < 0)
+        j->commit_errors++;
+    return seq;
+}
+
+uint64_t sc_journal_append(struct sc_journal * j, const unsigned char * frame, sc_size_t len)
+{
+    struct journal_rec * r;
+
+    r = journal_reserve(j, JOURNAL_REC_SIZE(len));
+    if (r == NULL)
+        return 0;
+    memcpy(r + 1, frame, len);
+    return journal_finish(j, r, len);
+}
+
+uint64_t sc_journal_append_message(struct sc_journal * j, struct sercomm * sc, sc_cmd_t cmd,
+        sc_cctrl_t cctrl, unsigned char * msg, sc_size_t mlen)
+{
+    struct journal_rec * r;
+    uint64_t room;
+    sc_size_t n = 0;
+
+    //Encode in place at the tail. If it does not fit, try again after a wrap
+    room = journal_contig(j);
+    if (room > sizeof(*r)) {
+        r = journal_rec_at(j, j->tail_off);
+        n = sc_make_message(sc, cmd, cctrl, msg, mlen, (unsigned char *)(r + 1),
+                (sc_size_t)(room - sizeof(*r)));
+    }
+    if (n == 0) {
+        room = journal_wrapped(j);
+        if (room <= sizeof(*r) || room <= journal_contig(j))
+            return 0;
+        r = journal_rec_at(j, 0);
+        n = sc_make_message(sc, cmd, cctrl, msg, mlen, (unsigned char *)(r + 1),
+                (sc_size_t)(room - sizeof(*r)));
+        if (n == 0)
+            return 0;
+        //The pad record would overwrite nothing of the new record: it is at the other end
+        journal_wrap(j);
+    }
+    return journal_finish(j, r, n);
+}
+
+void sc_journal_rewind(struct sc_journal * j, struct sc_journal_cursor * cur)
+{
+    cur->off = j->head_off;
+    cur->seq = j->head_seq;
+}
+
+uint64_t sc_journal_read(struct sc_journal * j, struct sc_journal_cursor * cur,
+        const unsigned char ** frame, sc_size_t * len)
+{
+    struct journal_rec * r;
+    uint64_t seq;
+
+    if (cur->seq < j->head_seq)
+        sc_journal_rewind(j, cur);
+    if (cur->seq >= j->tail_seq)
+        return 0;
+    if (j->capacity - cur->off < sizeof(*r))
+        cur->off = 0;
+    r = journal_rec_at(j, cur->off);
+    if (r->flags & JOURNAL_REC_PAD) {
+        cur->off = 0;
+        r = journal_rec_at(j, 0);
+    }
+    *frame = (const unsigned char *)(r + 1);
+    *len = r->len;
+    seq = cur->seq;
+    cur->off += JOURNAL_REC_SIZE(r->len);
+    if (cur->off == j->capacity)
+        cur->off = 0;
+    cur->seq++;
+    return seq;
+}
+
+int sc_journal_ack(struct sc_journal * j, uint64_t seq)
+{
+    struct journal_rec * r;
+    uint64_t size;
+
+    if (seq >= j->tail_seq)
+        return -1;
+    while (j->head_seq <= seq) {
+        if (j->capacity - j->head_off < sizeof(*r)) {
+            j->used -= j->capacity - j->head_off;
+            j->head_off = 0;
+            continue;
+        }
+        r = journal_rec_at(j, j->head_off);
+        if (r->flags & JOURNAL_REC_PAD) {
+            j->used -= j->capacity - j->head_off;
+            j->head_off = 0;
+            continue;
+        }
+        size = JOURNAL_REC_SIZE(r->len);
+        j->used -= size;
+        j->head_off += size;
+        if (j->head_off == j->capacity)
+            j->head_off = 0;
+        j->head_seq++;
+    }
+    journal_hdr_write(j);
+    return 0;
+}
+
+void sc_journal_stats(struct sc_journal * j, struct sc_journal_stats * st)
+{
+    st->capacity = j->capacity;
+    st->used = j->used;
+    st->frames = j->tail_seq - j->head_seq;
+    st->head_seq = j->head_seq;
+    st->tail_seq = j->tail_seq;
+    st->durable_seq = j->durable_seq;
+    st->commits = j->commits;
+    st->commit_errors = j->commit_errors;
+    st->recovered = j->recovered;
+}
+
+void sc_journal_close(struct sc_journal * j)
+{
+    if (j == NULL)
+        return;
+    sc_journal_commit(j);
+    munmap(j->map, j->map_size);
+    close(j->fd);
+    free(j);
+}
@@ -0,0 +1,197 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Persistent transmit journal
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_JOURNAL_H
+#define _SERCOMM_JOURNAL_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "sercomm.h"
+
+/*!
+ * \brief Crash-safe persistent transmit queue (POSIX host only)
+ *
+ * The journal is a memory-mapped file: a header page and a log-structured ring of encoded
+ * frames. sc_journal_append() copies the frame into the mapping, and
+ * sc_journal_append_message() encodes it there directly. Nothing is written to the disk
+ * until the group commit: one msync() for all the frames appended since the last commit.
+ * It runs automatically after every batch appends, or by sc_journal_commit() (i.e., from a
+ * periodic timer). The frames are durable after the commit.
+ *
+ * Each frame gets a sequence number. The sender reads the frames by a cursor, and
+ * sc_journal_ack() truncates the journal up to the acknowledged sequence number.
+ *
+ * Each record has a CRC-32, its sequence number and the generation (open count) of the
+ * journal. At the opening, the recovery scan follows the records from the head while the
+ * CRC, the sequence and the generation are consistent, so a torn commit loses only its
+ * own frames. The head is persisted at the next commit after the acknowledge, so a crash
+ * could send a few acknowledged frames again (at-least-once delivery).
+ *
+ * The journal is not thread-safe.
+ *
+ * Example:
+ * \code
+ * struct sc_journal * j = sc_journal_open("/var/spool/gw/tx.journal", 64 << 20, 64);
+ * struct sc_journal_cursor cur;
+ *
+ * sc_journal_append_message(j, &sc, MSG_COMMAND_LOG, 0, body, len);
+ * ...
+ * sc_journal_rewind(j, &cur);
+ * while ((seq = sc_journal_read(j, &cur, &frame, &n)) != 0)
+ *     uart_send(frame, n);
+ * ...
+ * sc_journal_ack(j, acked_seq);
+ * \endcode
+ */
+struct sc_journal;
+
+/*! \brief Read position in the journal */
+struct sc_journal_cursor {
+	/*! Internal usage: The offset of the next record in the ring */
+	uint64_t		off;
+	/*! Internal usage: The sequence number of the next record */
+	uint64_t		seq;
+};
+
+/*! \brief Journal statistics */
+struct sc_journal_stats {
+	/*! The size of the ring */
+	uint64_t		capacity;
+	/*! The number of used bytes in the ring */
+	uint64_t		used;
+	/*! The number of the frames in the journal */
+	uint64_t		frames;
+	/*! The sequence number of the oldest frame */
+	uint64_t		head_seq;
+	/*! The sequence number of the next frame */
+	uint64_t		tail_seq;
+	/*! The frames before this sequence number are durable */
+	uint64_t		durable_seq;
+	/*! The number of the commits */
+	uint64_t		commits;
+	/*! The number of the failed automatic commits */
+	uint64_t		commit_errors;
+	/*! The number of the frames found by the recovery scan */
+	uint64_t		recovered;
+};
+
+/*!
+ * \brief Open or create a journal
+ *
+ * \param path The file of the journal
+ * \param capacity The size of the ring for a new journal (an existing one keeps its size)
+ * \param batch The number of appends per automatic commit. Zero to commit only explicitly
+ *
+ * \return The journal, or NULL if error occured
+ */
+struct sc_journal * sc_journal_open(const char * path, size_t capacity, unsigned int batch);
+
+/*!
+ * \brief Append an encoded frame
+ *
+ * The frame is appended, even if the automatic commit fails: then it is not durable yet
+ * (see durable_seq and commit_errors in struct sc_journal_stats), and the next commit
+ * writes it.
+ *
+ * \param j The journal
+ * \param frame The frame
+ * \param len The length of the frame
+ *
+ * \return The sequence number of the frame, or zero if the journal is full or error occured
+ */
+uint64_t sc_journal_append(struct sc_journal * j, const unsigned char * frame, sc_size_t len);
+
+/*!
+ * \brief Encode a message into the journal
+ *
+ * The parameters are the same as of sc_make_message(). The failed automatic commit is
+ * handled like by sc_journal_append().
+ *
+ * \return The sequence number of the frame, or zero if the journal is full or error occured
+ */
+uint64_t sc_journal_append_message(struct sc_journal * j, struct sercomm * sc, sc_cmd_t cmd,
+        sc_cctrl_t cctrl, unsigned char * msg, sc_size_t mlen);
+
+/*!
+ * \brief Write the appended frames and the head to the disk
+ *
+ * \param j The journal
+ *
+ * \return Zero on success, or -1 if error occured
+ */
+int sc_journal_commit(struct sc_journal * j);
+
+/*!
+ * \brief Set the cursor to the oldest frame
+ *
+ * \param j The journal
+ * \param cur The cursor
+ */
+void sc_journal_rewind(struct sc_journal * j, struct sc_journal_cursor * cur);
+
+/*!
+ * \brief Read the next frame
+ *
+ * The frame points into the mapping. It is valid until the frame is acknowledged.
+ *
+ * \param j The journal
+ * \param cur The cursor
+ * \param frame Output: the frame
+ * \param len Output: the length of the frame
+ *
+ * \return The sequence number of the frame, or zero at the end of the journal
+ */
+uint64_t sc_journal_read(struct sc_journal * j, struct sc_journal_cursor * cur,
+        const unsigned char ** frame, sc_size_t * len);
+
+/*!
+ * \brief Truncate the journal
+ *
+ * \param j The journal
+ * \param seq The frames up to this sequence number (inclusive) are removed
+ *
+ * \return Zero on success, or -1 if the sequence number is not appended yet
+ */
+int sc_journal_ack(struct sc_journal * j, uint64_t seq);
+
+/*!
+ * \brief Get the statistics of the journal
+ *
+ * \param j The journal
+ * \param st The output
+ */
+void sc_journal_stats(struct sc_journal * j, struct sc_journal_stats * st);
+
+/*!
+ * \brief Commit and close the journal
+ *
+ * \param j The journal
+ */
+void sc_journal_close(struct sc_journal * j);
+
+#endif
+
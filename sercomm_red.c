@@ -0,0 +1,117 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Redundant dual-path delivery
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <string.h>
+
+#include "sercomm_red.h"
+#include "sercomm_util.h"
+
+void sc_red_init(struct sc_red * red)
+{
+    int i;
+
+    red->tx_seq = 0;
+    red->rx_top = 0;
+    red->rx_started = 0;
+    memset(red->window, 0, red->nwindow * sizeof(red->window[0]));
+    for (i = 0; i < 2; i++) {
+        red->path[i]->frame = sc_red_frame;
+        red->path[i]->priv = red;
+    }
+}
+
+sc_size_t sc_red_make_message(struct sc_red * red, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        unsigned char * msg, sc_size_t mlen,
+        unsigned char * output, sc_size_t olen)
+{
+    sc_size_t n;
+
+    n = sc_make_message_ts(red->path[0], cmd, cctrl, red->tx_seq, msg, mlen, output, olen);
+    if (n > 0)
+        red->tx_seq = (red->tx_seq + 1) & sc_ts_mask(red->path[0]);
+    return n;
+}
+
+/* The window entry is reused: the path, which did not deliver its copy, missed it */
+static void red_retire(struct sc_red * red, struct sc_red_entry * e)
+{
+    if (e->paths == 1)
+        red->stats[1].missed++;
+    else if (e->paths == 2)
+        red->stats[0].missed++;
+    e->paths = 0;
+}
+
+void sc_red_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_red * red = sc->priv;
+    struct sc_red_entry * e;
+    uint32_t mask = sc_ts_mask(sc), seq, d, now, lead;
+    uint8_t p = sc == red->path[0] ? 0 : 1, first;
+
+    (void)sm;
+    seq = sc_frame_ts(sc, f) & mask;
+    now = red->now != NULL ? red->now() : 0;
+    e = &red->window[seq & (red->nwindow - 1)];
+
+    if (!red->rx_started) {
+        red->rx_started = 1;
+        red->rx_top = seq;
+    }
+    d = (seq - red->rx_top) & mask;
+    if (d <= mask / 2) {
+        red->rx_top = seq;
+    } else if (((red->rx_top - seq) & mask) >= red->nwindow) {
+        //Older than the window: it could be a second copy or a very late first one
+        red->rx_too_old++;
+        return;
+    }
+
+    if (e->paths != 0 && e->seq == seq) {
+        if (e->paths & (1 << p)) {
+            //The same path repeated it (i.e., the sender retransmitted)
+            red->rx_suppressed++;
+            return;
+        }
+        e->paths |= 1 << p;
+        first = p ^ 1;
+        lead = now - e->time;
+        red->stats[first].lead_sum += lead;
+        if (lead > red->stats[first].lead_max)
+            red->stats[first].lead_max = lead;
+        red->rx_suppressed++;
+        return;
+    }
+
+    if (e->paths != 0)
+        red_retire(red, e);
+    e->seq = seq;
+    e->time = now;
+    e->paths = 1 << p;
+    red->stats[p].wins++;
+    red->rx_messages++;
+    sc_dispatch(red->sm, f, red->priv);
+}
+
@@ -0,0 +1,154 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Redundant dual-path delivery
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM_RED_H
+#define _SERCOMM_RED_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief Dedup window entry */
+struct sc_red_entry {
+	/*! Sequence number */
+	uint32_t		seq;
+	/*! The arrival time of the first copy */
+	uint32_t		time;
+	/*! Bit mask of the paths, which delivered a copy */
+	uint8_t			paths;
+};
+
+/*! \brief Statistics of one path */
+struct sc_red_path_stats {
+	/*! The number of messages, which arrived first on this path */
+	uint32_t		wins;
+	/*! The number of messages, which did not arrive on this path (only on the other one) */
+	uint32_t		missed;
+	/*! The sum of the leads of the wins (first arrival to second arrival time) */
+	uint32_t		lead_sum;
+	/*! The largest lead of a win */
+	uint32_t		lead_max;
+};
+
+/*!
+ * \brief Redundant dual-path link
+ *
+ * Every message is sent on both paths with the same sequence number in the Timestamp field.
+ * The receiver runs one parser per path, and it calls the command callback for the copy,
+ * which is validated first. The other copy is suppressed by a sequence number based dedup
+ * window, which is shared by the two parsers. The messages are delivered in arrival order
+ * for the minimal latency, so a message could overtake an earlier one, which is lost on the
+ * faster path.
+ *
+ * The time is read by the now callback at the validation of each copy, so the statistics
+ * show which path won and by how much. A copy, which does not arrive until its window
+ * entry is reused, counts as missed on its path.
+ *
+ * Both paths should use the same layout with a 1, 2 or 4 bytes long Timestamp field.
+ * The number of window entries should be a power of two.
+ *
+ * Example:
+ * \code
+ * static struct sc_red_entry window[64];
+ * static struct sc_red red = {
+ *     .path = { &sc_a, &sc_b }, .sm = sms, .window = window, .nwindow = 64, .now = now_us,
+ * };
+ *
+ * sc_red_init(&red);
+ * n = sc_red_make_message(&red, MSG_COMMAND_ALARM, 0, body, len, frame, sizeof(frame));
+ * uart_a_send(frame, n);
+ * uart_b_send(frame, n);
+ * ...
+ * sc_get_message(&sc_a, sms, byte_a);
+ * sc_get_message(&sc_b, sms, byte_b);
+ * \endcode
+ */
+struct sc_red {
+	/*! The parsers of the two paths */
+	struct sercomm * path[2];
+	/*! The struct sercomm_msg array */
+	struct sercomm_msg * sm;
+	/*! Last priv argument of the command callbacks */
+	void *			priv;
+	/*! Dedup window */
+	struct sc_red_entry * window;
+	/*! The number of the window entries (power of two) */
+	uint16_t		nwindow;
+	/*! Time callback (any monotonic unit). NULL to omit the lead statistics */
+	uint32_t		(* now)(void);
+	/*! Internal usage: The next sequence number to send */
+	uint32_t		tx_seq;
+	/*! Internal usage: The highest received sequence number */
+	uint32_t		rx_top;
+	/*! Internal usage: Any message received */
+	uint8_t			rx_started;
+	/*! Statistics of the paths */
+	struct sc_red_path_stats stats[2];
+	/*! Statistics: The number of delivered messages */
+	uint32_t		rx_messages;
+	/*! Statistics: The number of suppressed second copies */
+	uint32_t		rx_suppressed;
+	/*! Statistics: The number of dropped copies, which are older than the window */
+	uint32_t		rx_too_old;
+};
+
+/*!
+ * \brief Initialize the redundant link
+ *
+ * It resets the sequence numbers and the window, and sets the frame callback and the
+ * priv field of the struct sercomm of both paths.
+ *
+ * \param red The redundant link
+ */
+void sc_red_init(struct sc_red * red);
+
+/*!
+ * \brief Create a message for both paths
+ *
+ * The same output should be sent on both paths.
+ *
+ * \param red The redundant link
+ * \param cmd Message command value
+ * \param cctrl The value of the comm. control field
+ * \param msg Message body
+ * \param mlen The length of the message body
+ * \param output The output buffer
+ * \param olen The size of the output buffer
+ *
+ * \return The length of the message with the header, or zero if error occured
+ */
+sc_size_t sc_red_make_message(struct sc_red * red, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        unsigned char * msg, sc_size_t mlen,
+        unsigned char * output, sc_size_t olen);
+
+/*!
+ * \brief Frame callback of the redundant link
+ *
+ * sc_red_init() sets it in the struct sercomm of both paths.
+ */
+void sc_red_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+
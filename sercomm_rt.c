@@ -0,0 +1,686 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Sharded multi-core parser runtime
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "sercomm_rt.h"
+
+#define RT_READ_SIZE        4096
+#define RT_EVENTS           64
+#define RT_DISPATCH_BUDGET  64
+#define RT_IDLE_WAIT_MS     10
+/* A message counts as this many bytes in the load */
+#define RT_MESSAGE_LOAD     32
+/* The item sizes are rounded up to this, so the freed items fit the next messages */
+#define RT_ITEM_ROUND       64
+/* The maximal number of the free items per worker */
+#define RT_FREE_MAX         256
+
+struct rt_item {
+    struct rt_item *    next;
+    size_t              cap;            /* The size of data */
+    sc_cmd_t            cmd;
+    sc_size_t           mlen;
+    sc_cctrl_t          cctrl;
+    uint8_t             ts_bytes;
+    unsigned char       data[];         /* Timestamp field, then the message body */
+};
+
+struct rt_channel {
+    struct sc_rt *      rt;
+    int                 index;
+    struct sercomm *    sc;
+    struct sercomm_msg * sm;
+    int                 fd;
+    /* The worker which reads the fd */
+    int                 owner;
+    /* Set by the balancer: the worker to move to, or -1 */
+    int                 migrate_to;
+    int                 closed;
+    /* Protects the message queue and the scheduled flag */
+    pthread_mutex_t     lock;
+    struct rt_item *    head;
+    struct rt_item *    tail;
+    uint32_t            pending;
+    /* The channel is on a run queue, or it is being dispatched */
+    int                 scheduled;
+    /* Received bytes and messages, updated by the owner */
+    uint64_t            load;
+    uint64_t            load_prev;
+    uint64_t            rx_bytes;
+    uint64_t            messages;
+    uint64_t            stolen;
+    uint32_t            migrations;
+};
+
+struct rt_worker {
+    struct sc_rt *      rt;
+    int                 index;
+    pthread_t           thread;
+    int                 epfd;
+    int                 evfd;
+    int                 idle;
+    /* Protects the run queue and the inbox */
+    pthread_mutex_t     lock;
+    struct rt_channel ** runq;
+    int                 rq_head;
+    int                 rq_len;
+    struct rt_channel ** inbox;
+    int                 inbox_len;
+    /* Channels owned by this worker, only used by the worker itself */
+    struct rt_channel ** owned;
+    int                 owned_len;
+    /* Free message items, only used by the worker itself */
+    struct rt_item *    free_items;
+    int                 free_len;
+};
+
+struct sc_rt {
+    int                 nworkers;
+    struct rt_worker *  workers;
+    int                 max_channels;
+    int                 nchannels;
+    struct rt_channel * channels;
+    pthread_mutex_t     lock;
+    int                 running;
+    int                 stop;
+    unsigned int        rebalance_ms;
+    unsigned int        threshold_pct;
+    uint64_t            last_rebalance;
+};
+
+/* The channel, which is being read by the current thread. Used by the frame callback. */
+static __thread struct rt_channel * rt_current;
+/* The worker of the current thread */
+static __thread struct rt_worker * rt_self;
+
+static uint64_t rt_now_ms(void)
+{
+    struct timespec tp;
+
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (uint64_t)tp.tv_sec * 1000 + tp.tv_nsec / 1000000;
+}
+
+static void rt_kick(struct rt_worker * w)
+{
+    uint64_t one = 1;
+
+    if (write(w->evfd, &one, sizeof(one)) < 0) {
+        //The counter is already non-zero, the worker will wake up anyway
+    }
+}
+
+/* Wake up an idle worker to steal */
+static void rt_kick_idle(struct sc_rt * rt, struct rt_worker * self)
+{
+    int i;
+
+    for (i = 0; i < rt->nworkers; i++) {
+        if (&rt->workers[i] != self && __atomic_load_n(&rt->workers[i].idle, __ATOMIC_ACQUIRE)) {
+            rt_kick(&rt->workers[i]);
+            return;
+        }
+    }
+}
+
+static void rt_runq_push(struct rt_worker * w, struct rt_channel * ch)
+{
+    int len;
+
+    pthread_mutex_lock(&w->lock);
+    w->runq[(w->rq_head + w->rq_len) % w->rt->max_channels] = ch;
+    len = ++w->rq_len;
+    pthread_mutex_unlock(&w->lock);
+
+    if (len > 1)
+        rt_kick_idle(w->rt, w);
+    else if (__atomic_load_n(&w->idle, __ATOMIC_ACQUIRE))
+        rt_kick(w);
+}
+
+static struct rt_channel * rt_runq_pop(struct rt_worker * w)
+{
+    struct rt_channel * ch = NULL;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->rq_len > 0) {
+        ch = w->runq[w->rq_head];
+        w->rq_head = (w->rq_head + 1) % w->rt->max_channels;
+        w->rq_len--;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return ch;
+}
+
+/* Take a message item from the free list of the worker, or allocate one */
+static struct rt_item * rt_item_get(struct rt_worker * w, size_t size)
+{
+    struct rt_item * it = w->free_items;
+
+    if (it != NULL) {
+        w->free_items = it->next;
+        w->free_len--;
+        if (it->cap >= size)
+            return it;
+        free(it);
+    }
+    size = (size + RT_ITEM_ROUND - 1) / RT_ITEM_ROUND * RT_ITEM_ROUND;
+    it = malloc(sizeof(*it) + size);
+    if (it != NULL)
+        it->cap = size;
+    return it;
+}
+
+static void rt_item_put(struct rt_worker * w, struct rt_item * it)
+{
+    if (w->free_len >= RT_FREE_MAX) {
+        free(it);
+        return;
+    }
+    it->next = w->free_items;
+    w->free_items = it;
+    w->free_len++;
+}
+
+static void rt_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct rt_channel * ch = rt_current;
+    struct rt_item * it;
+    int push = 0;
+
+    (void)sm;
+    it = rt_item_get(rt_self, (size_t)sc->ts_bytes + f->mlen);
+    if (it == NULL)
+        return;
+    it->next = NULL;
+    it->cmd = f->cmd;
+    it->mlen = f->mlen;
+    it->cctrl = f->cctrl;
+    it->ts_bytes = sc->ts_bytes;
+    memcpy(it->data, f->ts, sc->ts_bytes);
+    memcpy(&it->data[sc->ts_bytes], f->msg, f->mlen);
+
+    pthread_mutex_lock(&ch->lock);
+    if (ch->tail != NULL)
+        ch->tail->next = it;
+    else
+        ch->head = it;
+    ch->tail = it;
+    ch->pending++;
+    if (!ch->scheduled) {
+        ch->scheduled = 1;
+        push = 1;
+    }
+    pthread_mutex_unlock(&ch->lock);
+
+    __atomic_store_n(&ch->load, ch->load + RT_MESSAGE_LOAD, __ATOMIC_RELAXED);
+    if (push)
+        rt_runq_push(&ch->rt->workers[__atomic_load_n(&ch->owner, __ATOMIC_ACQUIRE)], ch);
+}
+
+/* Dispatch one message of a scheduled channel from the run queue of the victim */
+static int rt_run_one(struct rt_worker * self, struct rt_worker * victim)
+{
+    struct rt_channel * ch;
+    struct rt_item * it;
+    struct sercomm_frame f;
+    int owner, again;
+
+    if ((ch = rt_runq_pop(victim)) == NULL)
+        return 0;
+
+    pthread_mutex_lock(&ch->lock);
+    it = ch->head;
+    ch->head = it->next;
+    if (ch->head == NULL)
+        ch->tail = NULL;
+    ch->pending--;
+    pthread_mutex_unlock(&ch->lock);
+
+    f.ts = it->data;
+    f.cmd = it->cmd;
+    f.mlen = it->mlen;
+    f.msg = &it->data[it->ts_bytes];
+    f.cctrl = it->cctrl;
+    sc_dispatch(ch->sm, &f, ch->sc->priv);
+    rt_item_put(self, it);
+
+    owner = __atomic_load_n(&ch->owner, __ATOMIC_ACQUIRE);
+    pthread_mutex_lock(&ch->lock);
+    ch->messages++;
+    if (self->index != owner)
+        ch->stolen++;
+    again = ch->head != NULL;
+    if (!again)
+        ch->scheduled = 0;
+    pthread_mutex_unlock(&ch->lock);
+
+    //The rest of the messages of the channel goes back to the owner
+    if (again)
+        rt_runq_push(&self->rt->workers[owner], ch);
+    return 1;
+}
+
+static void rt_adopt(struct rt_worker * w)
+{
+    struct rt_channel * in[RT_EVENTS];
+    struct epoll_event ev;
+    int n, i;
+
+    do {
+        pthread_mutex_lock(&w->lock);
+        n = w->inbox_len < RT_EVENTS ? w->inbox_len : RT_EVENTS;
+        w->inbox_len -= n;
+        memcpy(in, &w->inbox[w->inbox_len], n * sizeof(in[0]));
+        pthread_mutex_unlock(&w->lock);
+
+        for (i = 0; i < n; i++) {
+            __atomic_store_n(&in[i]->owner, w->index, __ATOMIC_RELEASE);
+            w->owned[w->owned_len++] = in[i];
+            if (__atomic_load_n(&in[i]->closed, __ATOMIC_RELAXED))
+                continue;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.ptr = in[i];
+            if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, in[i]->fd, &ev) < 0)
+                __atomic_store_n(&in[i]->closed, 1, __ATOMIC_RELAXED);
+        }
+    } while (n == RT_EVENTS);
+}
+
+static void rt_give(struct rt_worker * to, struct rt_channel * ch)
+{
+    pthread_mutex_lock(&to->lock);
+    to->inbox[to->inbox_len++] = ch;
+    pthread_mutex_unlock(&to->lock);
+    rt_kick(to);
+}
+
+/* Hand over the channels, which are selected by the balancer */
+static void rt_release(struct rt_worker * w)
+{
+    struct rt_channel * ch;
+    int i, to;
+
+    for (i = 0; i < w->owned_len; i++) {
+        ch = w->owned[i];
+        to = __atomic_load_n(&ch->migrate_to, __ATOMIC_ACQUIRE);
+        if (to < 0)
+            continue;
+        __atomic_store_n(&ch->migrate_to, -1, __ATOMIC_RELEASE);
+        if (to == w->index)
+            continue;
+        if (!__atomic_load_n(&ch->closed, __ATOMIC_RELAXED))
+            epoll_ctl(w->epfd, EPOLL_CTL_DEL, ch->fd, NULL);
+        w->owned[i--] = w->owned[--w->owned_len];
+        __atomic_store_n(&ch->migrations, ch->migrations + 1, __ATOMIC_RELAXED);
+        rt_give(&w->rt->workers[to], ch);
+    }
+}
+
+static void rt_read(struct rt_worker * w, struct rt_channel * ch)
+{
+    unsigned char buf[RT_READ_SIZE];
+    ssize_t n, i;
+
+    n = read(ch->fd, buf, sizeof(buf));
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return;
+    if (n <= 0) {
+        epoll_ctl(w->epfd, EPOLL_CTL_DEL, ch->fd, NULL);
+        __atomic_store_n(&ch->closed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    __atomic_store_n(&ch->rx_bytes, ch->rx_bytes + n, __ATOMIC_RELAXED);
+    __atomic_store_n(&ch->load, ch->load + n, __ATOMIC_RELAXED);
+    rt_current = ch;
+    for (i = 0; i < n; i++)
+        sc_get_message(ch->sc, ch->sm, buf[i]);
+    rt_current = NULL;
+}
+
+/* Move the best fitting channel from the busiest worker to the idlest one */
+static void rt_rebalance(struct sc_rt * rt)
+{
+    uint64_t wl[rt->nworkers], diff, d, best_d = 0;
+    struct rt_channel * ch, * best = NULL;
+    int i, hi = 0, lo = 0, n;
+
+    memset(wl, 0, sizeof(wl));
+    n = __atomic_load_n(&rt->nchannels, __ATOMIC_ACQUIRE);
+    for (i = 0; i < n; i++) {
+        ch = &rt->channels[i];
+        d = __atomic_load_n(&ch->load, __ATOMIC_RELAXED);
+        wl[__atomic_load_n(&ch->owner, __ATOMIC_ACQUIRE)] += d - ch->load_prev;
+    }
+    for (i = 1; i < rt->nworkers; i++) {
+        if (wl[i] > wl[hi])
+            hi = i;
+        if (wl[i] < wl[lo])
+            lo = i;
+    }
+
+    diff = wl[hi] - wl[lo];
+    if (hi != lo && wl[hi] > 0 && diff * 100 > (uint64_t)rt->threshold_pct * wl[hi]) {
+        //The moved load should be at most the half of the difference, or the workers swap
+        for (i = 0; i < n; i++) {
+            ch = &rt->channels[i];
+            if (__atomic_load_n(&ch->owner, __ATOMIC_ACQUIRE) != hi ||
+                    __atomic_load_n(&ch->closed, __ATOMIC_RELAXED) ||
+                    __atomic_load_n(&ch->migrate_to, __ATOMIC_ACQUIRE) >= 0)
+                continue;
+            d = __atomic_load_n(&ch->load, __ATOMIC_RELAXED) - ch->load_prev;
+            if (d > 0 && d <= diff / 2 && d > best_d) {
+                best = ch;
+                best_d = d;
+            }
+        }
+        if (best != NULL) {
+            __atomic_store_n(&best->migrate_to, lo, __ATOMIC_RELEASE);
+            rt_kick(&rt->workers[hi]);
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        rt->channels[i].load_prev = __atomic_load_n(&rt->channels[i].load, __ATOMIC_RELAXED);
+}
+
+static void * rt_worker_main(void * arg)
+{
+    struct rt_worker * w = arg;
+    struct sc_rt * rt = w->rt;
+    struct epoll_event evs[RT_EVENTS];
+    uint64_t cnt, now;
+    int n, i, budget, timeout;
+
+    rt_self = w;
+    while (!__atomic_load_n(&rt->stop, __ATOMIC_ACQUIRE)) {
+        rt_adopt(w);
+        rt_release(w);
+
+        pthread_mutex_lock(&w->lock);
+        timeout = w->rq_len > 0 || w->inbox_len > 0 ? 0 : RT_IDLE_WAIT_MS;
+        pthread_mutex_unlock(&w->lock);
+        if (timeout > 0)
+            __atomic_store_n(&w->idle, 1, __ATOMIC_RELEASE);
+        n = epoll_wait(w->epfd, evs, RT_EVENTS, timeout);
+        __atomic_store_n(&w->idle, 0, __ATOMIC_RELEASE);
+
+        for (i = 0; i < n; i++) {
+            if (evs[i].data.ptr == NULL) {
+                if (read(w->evfd, &cnt, sizeof(cnt)) < 0) {
+                    //Nothing to do, it is only a wake up
+                }
+                continue;
+            }
+            rt_read(w, evs[i].data.ptr);
+        }
+
+        for (budget = 0; budget < RT_DISPATCH_BUDGET; budget++) {
+            if (!rt_run_one(w, w))
+                break;
+        }
+        if (budget == 0) {
+            //Nothing to do: steal one message from the others
+            for (i = 1; i < rt->nworkers; i++) {
+                if (rt_run_one(w, &rt->workers[(w->index + i) % rt->nworkers]))
+                    break;
+            }
+        }
+
+        if (w->index == 0 && rt->rebalance_ms > 0) {
+            now = rt_now_ms();
+            if (now - rt->last_rebalance >= rt->rebalance_ms) {
+                rt->last_rebalance = now;
+                rt_rebalance(rt);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+struct sc_rt * sc_rt_create(int workers, int max_channels)
+{
+    struct sc_rt * rt;
+    struct rt_worker * w;
+    struct epoll_event ev;
+    int i;
+
+    if (workers <= 0)
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers <= 0)
+        workers = 1;
+    if (max_channels <= 0)
+        return NULL;
+
+    if ((rt = calloc(1, sizeof(*rt))) == NULL)
+        return NULL;
+    rt->nworkers = workers;
+    rt->max_channels = max_channels;
+    rt->rebalance_ms = 1000;
+    rt->threshold_pct = 25;
+    pthread_mutex_init(&rt->lock, NULL);
+    rt->channels = calloc(max_channels, sizeof(rt->channels[0]));
+    rt->workers = calloc(workers, sizeof(rt->workers[0]));
+    if (rt->channels == NULL || rt->workers == NULL)
+        goto error;
+
+    for (i = 0; i < workers; i++) {
+        w = &rt->workers[i];
+        w->rt = rt;
+        w->index = i;
+        w->epfd = -1;
+        w->evfd = -1;
+        pthread_mutex_init(&w->lock, NULL);
+        w->runq = calloc(max_channels, sizeof(w->runq[0]));
+        w->inbox = calloc(max_channels, sizeof(w->inbox[0]));
+        w->owned = calloc(max_channels, sizeof(w->owned[0]));
+        if (w->runq == NULL || w->inbox == NULL || w->owned == NULL)
+            goto error;
+        if ((w->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+            goto error;
+        if ((w->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+            goto error;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->evfd, &ev) < 0)
+            goto error;
+    }
+
+    return rt;
+
+error:
+    sc_rt_destroy(rt);
+    return NULL;
+}
+
+int sc_rt_add_channel(struct sc_rt * rt, struct sercomm * sc, struct sercomm_msg * sm, int fd)
+{
+    struct rt_channel * ch;
+    int flags, i, to = 0, min = -1, cnt;
+
+    flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        return -1;
+
+    pthread_mutex_lock(&rt->lock);
+    if (rt->nchannels >= rt->max_channels) {
+        pthread_mutex_unlock(&rt->lock);
+        return -1;
+    }
+    //Start on the worker with the least channels
+    for (i = 0; i < rt->nworkers; i++) {
+        cnt = 0;
+        for (flags = 0; flags < rt->nchannels; flags++) {
+            if (__atomic_load_n(&rt->channels[flags].owner, __ATOMIC_ACQUIRE) == i)
+                cnt++;
+        }
+        if (min < 0 || cnt < min) {
+            min = cnt;
+            to = i;
+        }
+    }
+    ch = &rt->channels[rt->nchannels];
+    memset(ch, 0, sizeof(*ch));
+    ch->rt = rt;
+    ch->index = rt->nchannels;
+    ch->sc = sc;
+    ch->sm = sm;
+    ch->fd = fd;
+    ch->owner = to;
+    ch->migrate_to = -1;
+    pthread_mutex_init(&ch->lock, NULL);
+    sc->frame = rt_frame;
+    __atomic_store_n(&rt->nchannels, rt->nchannels + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&rt->lock);
+
+    rt_give(&rt->workers[to], ch);
+    return ch->index;
+}
+
+void sc_rt_set_rebalance(struct sc_rt * rt, unsigned int interval_ms, unsigned int threshold_pct)
+{
+    rt->rebalance_ms = interval_ms;
+    rt->threshold_pct = threshold_pct;
+}
+
+int sc_rt_start(struct sc_rt * rt)
+{
+    int i;
+#ifdef __linux__
+    cpu_set_t cpus;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    if (rt->running)
+        return -1;
+    rt->stop = 0;
+    rt->last_rebalance = rt_now_ms();
+    for (i = 0; i < rt->nworkers; i++) {
+        if (pthread_create(&rt->workers[i].thread, NULL, rt_worker_main, &rt->workers[i]) != 0) {
+            __atomic_store_n(&rt->stop, 1, __ATOMIC_RELEASE);
+            while (--i >= 0)
+                pthread_join(rt->workers[i].thread, NULL);
+            return -1;
+        }
+#ifdef __linux__
+        if (ncpu > 0) {
+            CPU_ZERO(&cpus);
+            CPU_SET(i % ncpu, &cpus);
+            pthread_setaffinity_np(rt->workers[i].thread, sizeof(cpus), &cpus);
+        }
+#endif
+    }
+    rt->running = 1;
+    return 0;
+}
+
+void sc_rt_stop(struct sc_rt * rt)
+{
+    int i;
+
+    if (!rt->running)
+        return;
+    __atomic_store_n(&rt->stop, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < rt->nworkers; i++)
+        rt_kick(&rt->workers[i]);
+    for (i = 0; i < rt->nworkers; i++)
+        pthread_join(rt->workers[i].thread, NULL);
+    rt->running = 0;
+}
+
+void sc_rt_destroy(struct sc_rt * rt)
+{
+    struct rt_item * it;
+    int i;
+
+    if (rt == NULL)
+        return;
+    sc_rt_stop(rt);
+    for (i = 0; rt->workers != NULL && i < rt->nworkers; i++) {
+        if (rt->workers[i].epfd >= 0)
+            close(rt->workers[i].epfd);
+        if (rt->workers[i].evfd >= 0)
+            close(rt->workers[i].evfd);
+        free(rt->workers[i].runq);
+        free(rt->workers[i].inbox);
+        free(rt->workers[i].owned);
+        while ((it = rt->workers[i].free_items) != NULL) {
+            rt->workers[i].free_items = it->next;
+            free(it);
+        }
+        pthread_mutex_destroy(&rt->workers[i].lock);
+    }
+    for (i = 0; i < rt->nchannels; i++) {
+        while ((it = rt->channels[i].head) != NULL) {
+            rt->channels[i].head = it->next;
+            free(it);
+        }
+        rt->channels[i].sc->frame = NULL;
+        pthread_mutex_destroy(&rt->channels[i].lock);
+    }
+    free(rt->workers);
+    free(rt->channels);
+    pthread_mutex_destroy(&rt->lock);
+    free(rt);
+}
+
+int sc_rt_channel_stats(struct sc_rt * rt, int ch, struct sc_rt_channel_stats * st)
+{
+    struct rt_channel * c;
+
+    if (ch < 0 || ch >= __atomic_load_n(&rt->nchannels, __ATOMIC_ACQUIRE))
+        return -1;
+    c = &rt->channels[ch];
+    pthread_mutex_lock(&c->lock);
+    st->worker = __atomic_load_n(&c->owner, __ATOMIC_ACQUIRE);
+    st->rx_bytes = __atomic_load_n(&c->rx_bytes, __ATOMIC_RELAXED);
+    st->messages = c->messages;
+    st->stolen = c->stolen;
+    st->migrations = __atomic_load_n(&c->migrations, __ATOMIC_RELAXED);
+    st->pending = c->pending;
+    st->closed = __atomic_load_n(&c->closed, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&c->lock);
+    return 0;
+}
+
@@ -0,0 +1,155 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Sharded multi-core parser runtime
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM_RT_H
+#define _SERCOMM_RT_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*!
+ * \brief Sharded multi-core parser runtime (Linux host only)
+ *
+ * The runtime runs one event loop (epoll) per worker thread, and each worker owns a shard
+ * of the channels (a struct sercomm with its struct sercomm_msg array and file descriptor).
+ * Only the owner worker reads the fd and feeds the parser, so the byte order of a channel
+ * is kept.
+ *
+ * Validated messages are copied into per-channel work queues. A channel with pending
+ * messages is scheduled on the run queue of its owner, and an idle worker could steal it
+ * from there: one message is processed at a time, and a channel is processed by
+ * only one worker at once, so the dispatch order of a channel is kept too.
+ *
+ * The first worker periodically compares the load (received bytes and messages) of the
+ * workers, and moves a channel from the busiest worker to the idlest one, if the difference
+ * is larger than the threshold.
+ *
+ * The runtime uses the frame callback of the struct sercomm of its channels.
+ *
+ * Example:
+ * \code
+ * struct sc_rt * rt = sc_rt_create(0, 512);
+ *
+ * for (i = 0; i < nports; i++)
+ *     sc_rt_add_channel(rt, ports[i].sc, sms, ports[i].fd);
+ * sc_rt_start(rt);
+ * ...
+ * sc_rt_stop(rt);
+ * sc_rt_destroy(rt);
+ * \endcode
+ */
+struct sc_rt;
+
+/*! \brief Runtime statistics of a channel */
+struct sc_rt_channel_stats {
+	/*! The index of the worker, which owns the channel */
+	int				worker;
+	/*! The number of received bytes */
+	uint64_t		rx_bytes;
+	/*! The number of dispatched messages */
+	uint64_t		messages;
+	/*! The number of messages dispatched by a worker other than the owner */
+	uint64_t		stolen;
+	/*! The number of moves between workers */
+	uint32_t		migrations;
+	/*! The number of messages waiting for dispatch */
+	uint32_t		pending;
+	/*! Non-zero, if the fd is closed or failed */
+	int				closed;
+};
+
+/*!
+ * \brief Create a runtime
+ *
+ * \param workers The number of worker threads. Zero to use one per online CPU
+ * \param max_channels The maximum number of channels
+ *
+ * \return The new runtime, or NULL if error occured
+ */
+struct sc_rt * sc_rt_create(int workers, int max_channels);
+
+/*!
+ * \brief Add a channel to the runtime
+ *
+ * The fd is switched to non-blocking mode. The runtime does not close it.
+ * Channels could be added before or after sc_rt_start().
+ *
+ * \param rt The runtime
+ * \param sc The parser of the channel
+ * \param sm The struct sercomm_msg array of the channel
+ * \param fd The file descriptor to read
+ *
+ * \return The index of the channel, or -1 if error occured
+ */
+int sc_rt_add_channel(struct sc_rt * rt, struct sercomm * sc, struct sercomm_msg * sm, int fd);
+
+/*!
+ * \brief Set the load balancing parameters
+ *
+ * \param rt The runtime
+ * \param interval_ms The period of the load comparison. Zero to disable channel moves
+ * \param threshold_pct The minimum load difference (percent of the busiest worker) to move a channel
+ */
+void sc_rt_set_rebalance(struct sc_rt * rt, unsigned int interval_ms, unsigned int threshold_pct);
+
+/*!
+ * \brief Start the worker threads
+ *
+ * \param rt The runtime
+ *
+ * \return Zero on success, or -1 if error occured
+ */
+int sc_rt_start(struct sc_rt * rt);
+
+/*!
+ * \brief Stop and join the worker threads
+ *
+ * The messages waiting for dispatch are kept, and they are dispatched after the next sc_rt_start().
+ *
+ * \param rt The runtime
+ */
+void sc_rt_stop(struct sc_rt * rt);
+
+/*!
+ * \brief Free the runtime
+ *
+ * \param rt The runtime. It should be stopped.
+ */
+void sc_rt_destroy(struct sc_rt * rt);
+
+/*!
+ * \brief Get the statistics of a channel
+ *
+ * \param rt The runtime
+ * \param ch The index of the channel
+ * \param st The output
+ *
+ * \return Zero on success, or -1 if the channel does not exist
+ */
+int sc_rt_channel_stats(struct sc_rt * rt, int ch, struct sc_rt_channel_stats * st);
+
+#endif
+
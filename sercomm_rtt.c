@@ -0,0 +1,164 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Round trip time probe
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <string.h>
+
+#include "sercomm_rtt.h"
+#include "sercomm_util.h"
+
+/* The number of the echos before the regression detection (the slow average settles) */
+#define RTT_WARMUP			16
+
+void sc_rtt_init(struct sc_rtt * rtt, struct sercomm * sc)
+{
+    rtt->sc = sc;
+    rtt->echo_pending = 0;
+    rtt->outstanding = 0;
+    rtt->fast = 0;
+    rtt->slow = 0;
+    rtt->alerting = 0;
+    rtt->rtt_last = 0;
+    memset(rtt->hist, 0, sizeof(rtt->hist));
+    rtt->rtt_min = UINT32_MAX;
+    rtt->rtt_max = 0;
+    rtt->tx_probes = 0;
+    rtt->rx_echos = 0;
+    rtt->lost = 0;
+    sc->frame = sc_rtt_frame;
+    sc->priv = rtt;
+}
+
+static void rtt_set_alert(struct sc_rtt * rtt, uint8_t active)
+{
+    if (rtt->alerting == active)
+        return;
+    rtt->alerting = active;
+    if (rtt->alert != NULL)
+        rtt->alert(rtt, active);
+}
+
+sc_size_t sc_rtt_next(struct sc_rtt * rtt, unsigned char * output, sc_size_t olen)
+{
+    struct sercomm * sc = rtt->sc;
+    uint32_t now = rtt->now();
+    unsigned char body[4];
+    sc_size_t n;
+
+    if (rtt->echo_pending) {
+        n = sc_make_message_ts(sc, rtt->echo_cmd, 0, rtt->echo_ts, rtt->echo_body, rtt->echo_len,
+                output, olen);
+        if (n > 0)
+            rtt->echo_pending = 0;
+        return n;
+    }
+
+    if (rtt->outstanding && now - rtt->probe_time >= rtt->timeout) {
+        rtt->outstanding = 0;
+        rtt->lost++;
+        if (rtt->threshold > 0)
+            rtt_set_alert(rtt, 1);
+    }
+    if (rtt->interval == 0 || rtt->outstanding)
+        return 0;
+    if (rtt->tx_probes > 0 && now - rtt->probe_time < rtt->interval)
+        return 0;
+
+    if (sc->ts_bytes == 4) {
+        n = sc_make_message_ts(sc, rtt->probe_cmd, 0, now, NULL, 0, output, olen);
+    } else {
+        memcpy(body, &now, sizeof(now));
+        n = sc_make_message_ts(sc, rtt->probe_cmd, 0, 0, body, sizeof(body), output, olen);
+    }
+    if (n == 0)
+        return 0;
+    rtt->probe_time = now;
+    rtt->outstanding = 1;
+    rtt->tx_probes++;
+    return n;
+}
+
+static void rtt_account(struct sc_rtt * rtt, uint32_t sample)
+{
+    sc_hist_add(rtt->hist, SC_RTT_HIST_BUCKETS, sample);
+    if (sample < rtt->rtt_min)
+        rtt->rtt_min = sample;
+    if (sample > rtt->rtt_max)
+        rtt->rtt_max = sample;
+    rtt->rtt_last = sample;
+    rtt->rx_echos++;
+
+    if (rtt->rx_echos == 1) {
+        rtt->fast = sample * 16;
+        rtt->slow = sample * 16;
+    } else {
+        rtt->fast = (uint32_t)((int32_t)rtt->fast + ((int32_t)(sample * 16) - (int32_t)rtt->fast) / 4);
+        rtt->slow = (uint32_t)((int32_t)rtt->slow + ((int32_t)(sample * 16) - (int32_t)rtt->slow) / 64);
+    }
+
+    if (rtt->threshold == 0 || rtt->rx_echos < RTT_WARMUP)
+        return;
+    if ((uint64_t)rtt->fast * 100 > (uint64_t)rtt->slow * (100 + rtt->threshold))
+        rtt_set_alert(rtt, 1);
+    else if ((uint64_t)rtt->fast * 100 <= (uint64_t)rtt->slow * (100 + rtt->threshold / 2))
+        rtt_set_alert(rtt, 0);
+}
+
+uint32_t sc_rtt_percentile(struct sc_rtt * rtt, uint8_t pct)
+{
+    return sc_hist_percentile(rtt->hist, SC_RTT_HIST_BUCKETS, 0, pct);
+}
+
+void sc_rtt_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_rtt * rtt = sc->priv;
+    uint32_t sent;
+
+    if (f->cmd == rtt->probe_cmd) {
+        if (f->mlen > sizeof(rtt->echo_body))
+            return;
+        rtt->echo_ts = sc_frame_ts(sc, f);
+        if (f->mlen > 0)
+            memcpy(rtt->echo_body, f->msg, f->mlen);
+        rtt->echo_len = f->mlen;
+        rtt->echo_pending = 1;
+        return;
+    }
+    if (f->cmd == rtt->echo_cmd) {
+        if (sc->ts_bytes == 4)
+            sent = sc_frame_ts(sc, f);
+        else if (f->mlen == sizeof(sent))
+            memcpy(&sent, f->msg, sizeof(sent));
+        else
+            return;
+        //Only the echo of the outstanding probe: the late ones are already counted as lost
+        if (!rtt->outstanding || sent != rtt->probe_time)
+            return;
+        rtt->outstanding = 0;
+        rtt_account(rtt, rtt->now() - sent);
+        return;
+    }
+    sc_dispatch(sm, f, rtt->priv);
+}
@@ -0,0 +1,159 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Round trip time probe
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_RTT_H
+#define _SERCOMM_RTT_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief The number of the RTT histogram buckets */
+#define SC_RTT_HIST_BUCKETS					24
+
+/*!
+ * \brief Round trip time probe
+ *
+ * It measures the round trip time of a link continuously with a reserved probe and echo
+ * command pair. Both peers use it: the probes are answered inside the library, so the device
+ * needs no echo command of its own.
+ *
+ * The probe carries its send time: in the Timestamp field, if it is 4 bytes long, or else in a
+ * 4 bytes long body. The echo copies it, so the RTT does not depend on the clock of the peer.
+ * One probe is outstanding at a time. It is lost, if its echo does not arrive in timeout.
+ *
+ * sc_rtt_next() gives the pending echo first, then the next probe, when the interval is over.
+ * Call it before sending the other messages, so the probes are not queued behind them.
+ *
+ * The RTT is added to a log2 histogram. The regression detector compares a fast (1/4) and a
+ * slow (1/64) moving average of the RTT. The alert callback is called with active = 1, when
+ * the fast one exceeds the slow one by threshold percent (or the probes are lost), and with
+ * active = 0, when it is back under the half of the threshold.
+ *
+ * Example:
+ * \code
+ * static struct sc_rtt rtt = {
+ *     .probe_cmd = MSG_COMMAND_PROBE, .echo_cmd = MSG_COMMAND_ECHO, .now = now_ms,
+ *     .interval = 1000, .timeout = 500, .threshold = 50, .alert = rtt_alert,
+ * };
+ *
+ * sc_rtt_init(&rtt, &sc);
+ * ...
+ * sc_get_message(&sc, sms, byte);
+ * n = sc_rtt_next(&rtt, frame, sizeof(frame));
+ * if (n > 0)
+ *     uart_send(frame, n);
+ * \endcode
+ */
+struct sc_rtt {
+	/*! The parser of the link */
+	struct sercomm * sc;
+	/*! Last priv argument of the command callbacks */
+	void *			priv;
+	/*! Command value of the probe */
+	sc_cmd_t		probe_cmd;
+	/*! Command value of the echo */
+	sc_cmd_t		echo_cmd;
+	/*! Clock callback (any unit, i.e., milliseconds) */
+	uint32_t		(* now)(void);
+	/*! The time between the probes. Zero to answer only */
+	uint32_t		interval;
+	/*! The maximal waiting time for the echo */
+	uint32_t		timeout;
+	/*! Regression threshold in percent of the slow average. Zero to omit the alerts */
+	uint16_t		threshold;
+	/*! Alert callback: active is 1 on a latency regression, and 0 when it is over. NULL to omit */
+	void			(* alert)(struct sc_rtt * rtt, uint8_t active);
+	/*! Internal usage: The echo is pending */
+	uint8_t			echo_pending;
+	/*! Internal usage: The Timestamp field and body of the pending echo */
+	uint32_t		echo_ts;
+	unsigned char	echo_body[4];
+	sc_size_t		echo_len;
+	/*! Internal usage: A probe is outstanding */
+	uint8_t			outstanding;
+	/*! Internal usage: The send time of the last probe */
+	uint32_t		probe_time;
+	/*! Internal usage: The moving averages of the RTT, scaled by 16 */
+	uint32_t		fast, slow;
+	/*! Non-zero, if an alert is active */
+	uint8_t			alerting;
+	/*! The last RTT */
+	uint32_t		rtt_last;
+	/*! RTT histogram: bucket 0 is zero, bucket i is [2^(i-1), 2^i), the last one is open */
+	uint32_t		hist[SC_RTT_HIST_BUCKETS];
+	/*! Statistics: The smallest RTT */
+	uint32_t		rtt_min;
+	/*! Statistics: The largest RTT */
+	uint32_t		rtt_max;
+	/*! Statistics: The number of the sent probes */
+	uint32_t		tx_probes;
+	/*! Statistics: The number of the received echos */
+	uint32_t		rx_echos;
+	/*! Statistics: The number of the lost probes */
+	uint32_t		lost;
+};
+
+/*!
+ * \brief Initialize the RTT probe
+ *
+ * It resets the state and the statistics, and sets the frame callback and the priv field of sc.
+ *
+ * \param rtt The RTT probe
+ * \param sc The parser of the link
+ */
+void sc_rtt_init(struct sc_rtt * rtt, struct sercomm * sc);
+
+/*!
+ * \brief Create the next probe or echo message
+ *
+ * \param rtt The RTT probe
+ * \param output The output buffer
+ * \param olen The size of the output buffer
+ *
+ * \return The length of the message with the header, or zero if there is nothing to send
+ */
+sc_size_t sc_rtt_next(struct sc_rtt * rtt, unsigned char * output, sc_size_t olen);
+
+/*!
+ * \brief Get a percentile of the RTT histogram
+ *
+ * \param rtt The RTT probe
+ * \param pct The percentile (0 - 100)
+ *
+ * \return The upper bound of the bucket, which contains the percentile
+ */
+uint32_t sc_rtt_percentile(struct sc_rtt * rtt, uint8_t pct);
+
+/*!
+ * \brief Frame callback of the RTT probe
+ *
+ * sc_rtt_init() sets it in the struct sercomm of the link.
+ */
+void sc_rtt_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+
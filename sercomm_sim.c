@@ -0,0 +1,307 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Deterministic serial link simulator
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include "sercomm_sim.h"
+
+enum sim_event {
+    SIM_NONE,
+    SIM_TX,
+    SIM_LINK,
+    SIM_READ,
+};
+
+/* xorshift32: the same seed gives the same noise on every platform */
+static uint32_t sim_rand(struct sc_sim_link * l)
+{
+    uint32_t x = l->rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    l->rng = x;
+    return x;
+}
+
+/* Move the next byte of the transmit buffer to the transmitter */
+static void tx_start(struct sc_sim_end * e, uint64_t at)
+{
+    uint64_t total;
+
+    if (e->tx_count == 0) {
+        e->tx_busy = 0;
+        return;
+    }
+    e->tx_byte = e->tx_buf[e->tx_head];
+    e->tx_head = (e->tx_head + 1) % e->tx_size;
+    e->tx_count--;
+
+    //The remainder is carried over, so the line does not drift at odd baud rates
+    total = (uint64_t)e->bits * 1000000000ULL + e->tx_rem;
+    e->tx_done = at + total / e->baud;
+    e->tx_rem = total % e->baud;
+    e->tx_busy = 1;
+}
+
+/* Schedule the first read after now on the read_interval grid */
+static void read_arm(struct sc_sim_end * e, uint64_t now)
+{
+    if (e->read_armed)
+        return;
+    if (e->read_interval == 0)
+        e->next_read = now;
+    else
+        e->next_read = (now + e->read_interval - 1) / e->read_interval * e->read_interval;
+    e->read_armed = 1;
+}
+
+int sc_sim_init(struct sc_sim * sim)
+{
+    struct sc_sim_end * e;
+    struct sc_sim_link * l;
+    uint8_t i;
+
+    for (i = 0; i < sim->nends; i++) {
+        e = &sim->ends[i];
+        if (e->baud == 0 || e->bits == 0 || e->tx_size == 0 || e->rx_size == 0)
+            return -1;
+        //A poll callback with zero interval would never let the time go
+        if (e->poll != NULL && e->read_interval == 0)
+            return -1;
+    }
+    for (i = 0; i < sim->nlinks; i++) {
+        l = &sim->links[i];
+        if (l->from >= sim->nends || l->to >= sim->nends || l->fly_size == 0)
+            return -1;
+    }
+
+    sim->now = 0;
+    sim->events = 0;
+    for (i = 0; i < sim->nends; i++) {
+        e = &sim->ends[i];
+        e->tx_head = 0;
+        e->tx_count = 0;
+        e->rx_head = 0;
+        e->rx_count = 0;
+        e->tx_busy = 0;
+        e->tx_rem = 0;
+        e->read_armed = 0;
+        if (e->poll != NULL)
+            read_arm(e, 0);
+    }
+    for (i = 0; i < sim->nlinks; i++) {
+        l = &sim->links[i];
+        l->fly_head = 0;
+        l->fly_count = 0;
+        l->rng = l->seed != 0 ? l->seed : 1;
+    }
+    return 0;
+}
+
+uint32_t sc_sim_tx_room(struct sc_sim * sim, uint8_t end)
+{
+    struct sc_sim_end * e;
+
+    if (end >= sim->nends)
+        return 0;
+    e = &sim->ends[end];
+    return e->tx_size - e->tx_count;
+}
+
+uint32_t sc_sim_write(struct sc_sim * sim, uint8_t end, const unsigned char * data, uint32_t len)
+{
+    struct sc_sim_end * e;
+    uint32_t n, i;
+
+    if (end >= sim->nends)
+        return 0;
+    e = &sim->ends[end];
+    n = e->tx_size - e->tx_count;
+    if (n > len)
+        n = len;
+    e->tx_refused += len - n;
+    for (i = 0; i < n; i++)
+        e->tx_buf[(e->tx_head + e->tx_count + i) % e->tx_size] = data[i];
+    e->tx_count += n;
+    if (!e->tx_busy)
+        tx_start(e, sim->now);
+    return n;
+}
+
+/* The byte has left the transmitter: put it on the wires */
+static void do_tx(struct sc_sim * sim, uint8_t idx)
+{
+    struct sc_sim_end * e = &sim->ends[idx];
+    struct sc_sim_link * l;
+    struct sc_sim_byte * b;
+    unsigned char byte;
+    uint8_t i;
+
+    for (i = 0; i < sim->nlinks; i++) {
+        l = &sim->links[i];
+        if (l->from != idx)
+            continue;
+        byte = e->tx_byte;
+        //Draw for every byte, so the noise does not depend on the other settings
+        if (sim_rand(l) % 1000000 < l->noise_ppm) {
+            byte ^= 1 << (sim_rand(l) & 7);
+            l->corrupted++;
+        }
+        if (l->fly_count >= l->fly_size) {
+            l->dropped++;
+            continue;
+        }
+        b = &l->fly[(l->fly_head + l->fly_count) % l->fly_size];
+        b->time = e->tx_done + l->delay;
+        b->byte = byte;
+        l->fly_count++;
+    }
+    e->tx_bytes++;
+    tx_start(e, e->tx_done);
+}
+
+/* The byte has arrived: put it into the receive buffer */
+static void do_link(struct sc_sim * sim, uint8_t idx)
+{
+    struct sc_sim_link * l = &sim->links[idx];
+    struct sc_sim_end * e = &sim->ends[l->to];
+    unsigned char byte;
+
+    byte = l->fly[l->fly_head].byte;
+    l->fly_head = (l->fly_head + 1) % l->fly_size;
+    l->fly_count--;
+
+    if (e->rx_count >= e->rx_size) {
+        e->rx_overruns++;
+        return;
+    }
+    e->rx_buf[(e->rx_head + e->rx_count) % e->rx_size] = byte;
+    e->rx_count++;
+    read_arm(e, sim->now);
+}
+
+static void do_read(struct sc_sim * sim, uint8_t idx)
+{
+    struct sc_sim_end * e = &sim->ends[idx];
+    uint32_t n, i;
+    unsigned char byte;
+
+    n = e->rx_count;
+    if (e->read_chunk > 0 && n > e->read_chunk)
+        n = e->read_chunk;
+    for (i = 0; i < n; i++) {
+        byte = e->rx_buf[e->rx_head];
+        e->rx_head = (e->rx_head + 1) % e->rx_size;
+        e->rx_count--;
+        sc_get_message(e->sc, e->sm, byte);
+    }
+    e->rx_bytes += n;
+    if (n > 0)
+        e->reads++;
+
+    e->read_armed = 0;
+    if (e->poll != NULL)
+        e->poll(sim, idx);
+    if (e->poll != NULL || e->rx_count > 0) {
+        e->next_read = sim->now + e->read_interval;
+        e->read_armed = 1;
+    }
+}
+
+uint32_t sc_sim_run(struct sc_sim * sim, uint64_t until)
+{
+    struct sc_sim_end * e;
+    struct sc_sim_link * l;
+    enum sim_event kind;
+    uint64_t t;
+    uint32_t count = 0;
+    uint8_t i, idx = 0;
+
+    for (;;) {
+        //The earliest event; the strict compare keeps the fixed order of the ties
+        kind = SIM_NONE;
+        t = until;
+        for (i = 0; i < sim->nends; i++) {
+            e = &sim->ends[i];
+            if (e->tx_busy && (kind == SIM_NONE ? e->tx_done <= t : e->tx_done < t)) {
+                kind = SIM_TX;
+                idx = i;
+                t = e->tx_done;
+            }
+        }
+        for (i = 0; i < sim->nlinks; i++) {
+            l = &sim->links[i];
+            if (l->fly_count > 0 && (kind == SIM_NONE ? l->fly[l->fly_head].time <= t :
+                    l->fly[l->fly_head].time < t)) {
+                kind = SIM_LINK;
+                idx = i;
+                t = l->fly[l->fly_head].time;
+            }
+        }
+        for (i = 0; i < sim->nends; i++) {
+            e = &sim->ends[i];
+            if (e->read_armed && (kind == SIM_NONE ? e->next_read <= t : e->next_read < t)) {
+                kind = SIM_READ;
+                idx = i;
+                t = e->next_read;
+            }
+        }
+        if (kind == SIM_NONE)
+            break;
+
+        sim->now = t;
+        if (kind == SIM_TX)
+            do_tx(sim, idx);
+        else if (kind == SIM_LINK)
+            do_link(sim, idx);
+        else
+            do_read(sim, idx);
+        count++;
+    }
+    if (until > sim->now)
+        sim->now = until;
+    sim->events += count;
+    return count;
+}
+
+int sc_sim_idle(struct sc_sim * sim)
+{
+    struct sc_sim_end * e;
+    struct sc_sim_link * l;
+    uint8_t i;
+
+    for (i = 0; i < sim->nends; i++) {
+        e = &sim->ends[i];
+        if (e->tx_busy || e->tx_count > 0 || e->rx_count > 0)
+            return 0;
+    }
+    for (i = 0; i < sim->nlinks; i++) {
+        l = &sim->links[i];
+        if (l->fly_count > 0)
+            return 0;
+    }
+    return 1;
+}
+
@@ -0,0 +1,243 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Deterministic serial link simulator
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_SIM_H
+#define _SERCOMM_SIM_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+struct sc_sim;
+
+/*! \brief A byte on the wire of a link */
+struct sc_sim_byte {
+	/*! The arrival time at the receiver */
+	uint64_t		time;
+	/*! The value of the byte */
+	unsigned char	byte;
+};
+
+/*!
+ * \brief Simulated endpoint: a serial port with its kernel buffers and its reader
+ *
+ * The writes go into the transmit buffer. The transmitter sends one byte per byte time
+ * (bits * 10^9 / baud nanoseconds) to all the links of the endpoint. The arriving bytes
+ * go into the receive buffer, and the reader takes at most read_chunk bytes of it in every
+ * read_interval, and gives them to sc_get_message().
+ */
+struct sc_sim_end {
+	/*! The parser of the endpoint */
+	struct sercomm * sc;
+	/*! The struct sercomm_msg array of the parser */
+	struct sercomm_msg * sm;
+	/*! The line speed in bits per second */
+	uint32_t		baud;
+	/*! The number of bits per byte on the line (start, data, parity and stop bits; 10 for 8N1) */
+	uint8_t			bits;
+	/*! Transmit buffer storage (the kernel buffer of the writes) */
+	unsigned char * tx_buf;
+	/*! The size of the transmit buffer */
+	uint32_t		tx_size;
+	/*! Receive buffer storage (the kernel buffer of the reads) */
+	unsigned char * rx_buf;
+	/*! The size of the receive buffer. The bytes arriving to a full buffer are lost */
+	uint32_t		rx_size;
+	/*! The maximal number of bytes per read */
+	uint32_t		read_chunk;
+	/*! The period of the reads in nanoseconds (the wakeup latency of the reader) */
+	uint64_t		read_interval;
+	/*!
+	 * Optional callback after every read, also if nothing was received. Use it to write
+	 * in the virtual time. If it is NULL, the reader wakes up only for the received bytes.
+	 */
+	void			(* poll)(struct sc_sim * sim, uint8_t end);
+	/*! Free for the caller */
+	void *			priv;
+	/*! Internal usage: The first byte in the transmit buffer */
+	uint32_t		tx_head;
+	/*! Internal usage: The number of bytes in the transmit buffer */
+	uint32_t		tx_count;
+	/*! Internal usage: The first byte in the receive buffer */
+	uint32_t		rx_head;
+	/*! Internal usage: The number of bytes in the receive buffer */
+	uint32_t		rx_count;
+	/*! Internal usage: Non-zero, if the transmitter sends tx_byte */
+	uint8_t			tx_busy;
+	/*! Internal usage: The byte on the transmitter */
+	unsigned char	tx_byte;
+	/*! Internal usage: The end of the sending of tx_byte */
+	uint64_t		tx_done;
+	/*! Internal usage: The remainder of the byte time division */
+	uint64_t		tx_rem;
+	/*! Internal usage: Non-zero, if a read is scheduled */
+	uint8_t			read_armed;
+	/*! Internal usage: The time of the next read */
+	uint64_t		next_read;
+	/*! Statistics: The number of sent bytes */
+	uint32_t		tx_bytes;
+	/*! Statistics: The number of bytes refused by sc_sim_write() (full transmit buffer) */
+	uint32_t		tx_refused;
+	/*! Statistics: The number of read bytes */
+	uint32_t		rx_bytes;
+	/*! Statistics: The number of bytes lost in a full receive buffer */
+	uint32_t		rx_overruns;
+	/*! Statistics: The number of reads, which returned data */
+	uint32_t		reads;
+};
+
+/*!
+ * \brief Simulated wire from one endpoint to another
+ *
+ * A multidrop line is a link from the transmitter to each receiver. Collisions are not
+ * modelled: the bytes of more links into one endpoint are interleaved by their arrival time.
+ */
+struct sc_sim_link {
+	/*! The index of the transmitting endpoint */
+	uint8_t			from;
+	/*! The index of the receiving endpoint */
+	uint8_t			to;
+	/*! The propagation delay in nanoseconds */
+	uint64_t		delay;
+	/*! The probability of a corrupted byte (one flipped bit), in parts per million */
+	uint32_t		noise_ppm;
+	/*! The seed of the noise. The same seed gives the same errors */
+	uint32_t		seed;
+	/*! Storage of the bytes on the wire: at least delay / byte time + 1 entries */
+	struct sc_sim_byte * fly;
+	/*! The number of the fly entries */
+	uint32_t		fly_size;
+	/*! Internal usage: The first byte on the wire */
+	uint32_t		fly_head;
+	/*! Internal usage: The number of bytes on the wire */
+	uint32_t		fly_count;
+	/*! Internal usage: The state of the noise generator */
+	uint32_t		rng;
+	/*! Statistics: The number of corrupted bytes */
+	uint32_t		corrupted;
+	/*! Statistics: The number of bytes lost for the lack of fly entries */
+	uint32_t		dropped;
+};
+
+/*!
+ * \brief Deterministic serial link simulator
+ *
+ * It connects two or more endpoints running the encoder and the parser of the library in
+ * virtual time, so a benchmark gives the same numbers in every run, and runs faster than
+ * the real time. The events at the same time are processed in a fixed order: the
+ * transmitters, the links, then the reads, each in index order. The command callbacks
+ * could read the current virtual time from the now field.
+ *
+ * Example:
+ * \code
+ * static unsigned char tx0[4096], rx0[4096], tx1[4096], rx1[4096];
+ * static struct sc_sim_byte fly0[64], fly1[64];
+ * static struct sc_sim_end ends[] = {
+ *     { .sc = &sc0, .sm = sms, .baud = 115200, .bits = 10, .tx_buf = tx0, .tx_size = 4096,
+ *       .rx_buf = rx0, .rx_size = 4096, .read_chunk = 32, .read_interval = 1000000,
+ *       .poll = producer },
+ *     { .sc = &sc1, .sm = sms, .baud = 115200, .bits = 10, .tx_buf = tx1, .tx_size = 4096,
+ *       .rx_buf = rx1, .rx_size = 4096, .read_chunk = 32, .read_interval = 1000000 },
+ * };
+ * static struct sc_sim_link links[] = {
+ *     { .from = 0, .to = 1, .delay = 5000, .noise_ppm = 100, .seed = 1, .fly = fly0, .fly_size = 64 },
+ *     { .from = 1, .to = 0, .delay = 5000, .noise_ppm = 100, .seed = 2, .fly = fly1, .fly_size = 64 },
+ * };
+ * static struct sc_sim sim = { .ends = ends, .nends = 2, .links = links, .nlinks = 2 };
+ *
+ * sc_sim_init(&sim);
+ * sc_sim_run(&sim, 10000000000ULL);       // 10 seconds of virtual time
+ * \endcode
+ */
+struct sc_sim {
+	/*! The array of the endpoints */
+	struct sc_sim_end * ends;
+	/*! The number of the endpoints */
+	uint8_t			nends;
+	/*! The array of the links */
+	struct sc_sim_link * links;
+	/*! The number of the links */
+	uint8_t			nlinks;
+	/*! The current virtual time in nanoseconds */
+	uint64_t		now;
+	/*! Statistics: The number of processed events */
+	uint32_t		events;
+};
+
+/*!
+ * \brief Initialize the simulator
+ *
+ * It empties the buffers and the wires, seeds the noise, and sets the virtual time to zero.
+ *
+ * \param sim The simulator
+ *
+ * \return Zero on success, or -1 if the configuration is invalid
+ */
+int sc_sim_init(struct sc_sim * sim);
+
+/*!
+ * \brief Write to the transmit buffer of an endpoint at the current virtual time
+ *
+ * It works like a non-blocking write(): it accepts the bytes, which fit in the buffer.
+ *
+ * \param sim The simulator
+ * \param end The index of the endpoint
+ * \param data The bytes to send (i.e., the output of sc_make_message())
+ * \param len The number of bytes
+ *
+ * \return The number of accepted bytes
+ */
+uint32_t sc_sim_write(struct sc_sim * sim, uint8_t end, const unsigned char * data, uint32_t len);
+
+/*!
+ * \brief The free space in the transmit buffer of an endpoint
+ *
+ * \param sim The simulator
+ * \param end The index of the endpoint
+ */
+uint32_t sc_sim_tx_room(struct sc_sim * sim, uint8_t end);
+
+/*!
+ * \brief Process the events up to the given virtual time
+ *
+ * \param sim The simulator
+ * \param until The virtual time to stop at, in nanoseconds
+ *
+ * \return The number of processed events
+ */
+uint32_t sc_sim_run(struct sc_sim * sim, uint64_t until);
+
+/*!
+ * \brief Check whether the simulator has anything to do
+ *
+ * \param sim The simulator
+ *
+ * \return Non-zero, if all the buffers and wires are empty
+ */
+int sc_sim_idle(struct sc_sim * sim);
+
+#endif
+
@@ -0,0 +1,164 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Bidirectional sniffer
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <string.h>
+
+#include "sercomm_sniff.h"
+#include "sercomm_util.h"
+
+void sc_sniff_init(struct sc_sniff * sniff)
+{
+    struct sc_sniff_rule * r;
+    uint16_t i;
+    uint8_t d;
+
+    for (i = 0; i < sniff->nrules; i++) {
+        r = &sniff->rules[i];
+        memset(r->hist, 0, sizeof(r->hist));
+        r->count = 0;
+        r->sum = 0;
+        r->min = UINT32_MAX;
+        r->max = 0;
+        r->unanswered = 0;
+    }
+    for (i = 0; i < sniff->npending; i++)
+        sniff->pending[i].used = 0;
+    for (d = 0; d < 2; d++) {
+        sniff->nbytes[d] = 0;
+        sniff->messages[d] = 0;
+        sniff->sc[d]->frame = sc_sniff_frame;
+        sniff->sc[d]->priv = sniff;
+    }
+    sniff->unmatched = 0;
+}
+
+void sc_sniff_feed(struct sc_sniff * sniff, uint8_t dir, const unsigned char * data, sc_size_t len,
+        uint32_t now)
+{
+    struct sercomm * sc = sniff->sc[dir];
+    sc_size_t i, first, prev;
+
+    //The frame start is matched, when the buffer grows to its length
+    first = sc->frame_start_bytes > 0 ? sc->frame_start_bytes : 1;
+    if (first > SC_SNIFF_TIMES)
+        first = SC_SNIFF_TIMES;
+    sniff->now = now;
+    for (i = 0; i < len; i++) {
+        sniff->times[dir][sniff->nbytes[dir]++ % SC_SNIFF_TIMES] = now;
+        prev = sc->buffer_len;
+        sc_get_message(sc, NULL, data[i]);
+        if (sc->buffer_len == first && prev + 1 == first)
+            sniff->start[dir] = sniff->times[dir][(sniff->nbytes[dir] - first) % SC_SNIFF_TIMES];
+    }
+}
+
+static void sniff_account(struct sc_sniff * sniff, struct sc_sniff_rule * r, uint32_t time, uint32_t rt)
+{
+    sc_hist_add(r->hist, SC_SNIFF_HIST_BUCKETS, rt);
+    r->count++;
+    r->sum += rt;
+    if (rt < r->min)
+        r->min = rt;
+    if (rt > r->max)
+        r->max = rt;
+    if (sniff->pair != NULL)
+        sniff->pair(sniff, r, time, rt);
+}
+
+void sc_sniff_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_sniff * sniff = sc->priv;
+    struct sc_sniff_pending * p, * best = NULL;
+    struct sc_sniff_rule * r;
+    uint32_t seq, time;
+    uint16_t i;
+    uint8_t dir = sc == sniff->sc[1];
+
+    (void)sm;
+    sniff->messages[dir]++;
+    seq = sc_frame_ts(sc, f);
+    time = sniff->start[dir];
+
+    //Expire, and look for the oldest request of this response
+    for (i = 0; i < sniff->npending; i++) {
+        p = &sniff->pending[i];
+        if (!p->used)
+            continue;
+        r = &sniff->rules[p->rule];
+        if (sniff->timeout > 0 && sniff->now - p->time > sniff->timeout) {
+            p->used = 0;
+            r->unanswered++;
+            continue;
+        }
+        if (r->dir != dir && r->resp_cmd == f->cmd && (!r->match_seq || p->seq == seq) &&
+                (best == NULL || (int32_t)(p->time - best->time) < 0))
+            best = p;
+    }
+    if (best != NULL) {
+        best->used = 0;
+        sniff_account(sniff, &sniff->rules[best->rule], best->time, time - best->time);
+        return;
+    }
+
+    for (i = 0; i < sniff->nrules; i++) {
+        r = &sniff->rules[i];
+        if (r->dir == dir && r->req_cmd == f->cmd)
+            break;
+    }
+    if (i == sniff->nrules) {
+        for (i = 0; i < sniff->nrules; i++) {
+            if (sniff->rules[i].dir != dir && sniff->rules[i].resp_cmd == f->cmd) {
+                sniff->unmatched++;
+                break;
+            }
+        }
+        return;
+    }
+    if (sniff->npending == 0)
+        return;
+
+    //A free entry, or the oldest one
+    for (i = 0; i < sniff->npending; i++) {
+        p = &sniff->pending[i];
+        if (!p->used)
+            break;
+        if (best == NULL || (int32_t)(p->time - best->time) < 0)
+            best = p;
+    }
+    if (i == sniff->npending) {
+        p = best;
+        sniff->rules[p->rule].unanswered++;
+    }
+    p->time = time;
+    p->seq = seq;
+    p->rule = (uint8_t)(r - sniff->rules);
+    p->used = 1;
+}
+
+uint32_t sc_sniff_percentile(struct sc_sniff_rule * rule, uint8_t pct)
+{
+    return sc_hist_percentile(rule->hist, SC_SNIFF_HIST_BUCKETS, 0, pct);
+}
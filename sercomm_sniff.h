@@ -0,0 +1,177 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Bidirectional sniffer
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_SNIFF_H
+#define _SERCOMM_SNIFF_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief The number of the response time histogram buckets */
+#define SC_SNIFF_HIST_BUCKETS				24
+/*! \brief The number of the remembered byte arrival times per direction (longest frame start) */
+#define SC_SNIFF_TIMES						8
+
+/*! \brief Request and response matching rule */
+struct sc_sniff_rule {
+	/*! The direction of the request (0 or 1). The response arrives in the other direction */
+	uint8_t			dir;
+	/*! The command of the request */
+	sc_cmd_t		req_cmd;
+	/*! The command of the response */
+	sc_cmd_t		resp_cmd;
+	/*! Non-zero, if the Timestamp field (sequence number) of the response should match the request */
+	uint8_t			match_seq;
+	/*! Response time histogram: bucket 0 is zero, bucket i is [2^(i-1), 2^i), the last one is open */
+	uint32_t		hist[SC_SNIFF_HIST_BUCKETS];
+	/*! Statistics: The number of the paired requests */
+	uint32_t		count;
+	/*! Statistics: The sum of the response times */
+	uint64_t		sum;
+	/*! Statistics: The smallest response time */
+	uint32_t		min;
+	/*! Statistics: The largest response time */
+	uint32_t		max;
+	/*! Statistics: The number of the requests without response (timeout or no free entry) */
+	uint32_t		unanswered;
+};
+
+/*! \brief Outstanding request */
+struct sc_sniff_pending {
+	/*! The arrival time of the first byte of the request */
+	uint32_t		time;
+	/*! The value of the Timestamp field of the request */
+	uint32_t		seq;
+	/*! The index of the rule */
+	uint8_t			rule;
+	/*! Non-zero, if the entry holds a request */
+	uint8_t			used;
+};
+
+/*!
+ * \brief Passive bidirectional sniffer
+ *
+ * It runs two parsers on the two directions of a tapped link, and pairs the requests with
+ * the responses by the matching rules: the command pairs, and optionally the Timestamp field
+ * as a sequence number. The time of a message is the arrival of its first byte, so the response
+ * time includes the transmission time of the request, but not the one of the response. The
+ * response times are added to a log2 histogram of the rule, and they are passed to the pair
+ * callback too.
+ *
+ * A response is paired with the oldest matching request. A request, which is not answered in
+ * the timeout, or which is replaced, because no entry is free, counts as unanswered.
+ *
+ * Example:
+ * \code
+ * static struct sc_sniff_rule rules[] = {
+ *     { .dir = 0, .req_cmd = MSG_COMMAND_READ, .resp_cmd = MSG_COMMAND_READ_REPLY, .match_seq = 1 },
+ * };
+ * static struct sc_sniff_pending pending[32];
+ * static struct sc_sniff sniff = {
+ *     .sc = { &sc_host, &sc_device }, .rules = rules, .nrules = 1,
+ *     .pending = pending, .npending = 32, .timeout = 1000000,
+ * };
+ *
+ * sc_sniff_init(&sniff);
+ * n = read(fd_host_tx, buf, sizeof(buf));
+ * sc_sniff_feed(&sniff, 0, buf, n, now_us());
+ * ...
+ * p99 = sc_sniff_percentile(&rules[0], 99);
+ * \endcode
+ */
+struct sc_sniff {
+	/*! The parsers of the two directions. They should use the same layout */
+	struct sercomm * sc[2];
+	/*! Matching rules */
+	struct sc_sniff_rule * rules;
+	/*! The number of the rules */
+	uint8_t			nrules;
+	/*! Outstanding request entries */
+	struct sc_sniff_pending * pending;
+	/*! The number of the outstanding request entries */
+	uint16_t		npending;
+	/*! The maximal response time. Zero for no timeout */
+	uint32_t		timeout;
+	/*! Optional pair callback: the rule, the time of the request and the response time */
+	void			(* pair)(struct sc_sniff * sniff, struct sc_sniff_rule * rule,
+							uint32_t time, uint32_t rt);
+	/*! Last argument of the pair callback, free for the caller */
+	void *			priv;
+	/*! Internal usage: The arrival times of the last bytes per direction */
+	uint32_t		times[2][SC_SNIFF_TIMES];
+	/*! Internal usage: The number of the received bytes per direction */
+	uint32_t		nbytes[2];
+	/*! Internal usage: The arrival time of the first byte of the current message per direction */
+	uint32_t		start[2];
+	/*! Internal usage: The last time given to the library */
+	uint32_t		now;
+	/*! Statistics: The number of the messages per direction */
+	uint32_t		messages[2];
+	/*! Statistics: The number of the responses without a request */
+	uint32_t		unmatched;
+};
+
+/*!
+ * \brief Initialize the sniffer
+ *
+ * It resets the statistics, and sets the frame callback and the priv field of both parsers.
+ *
+ * \param sniff The sniffer
+ */
+void sc_sniff_init(struct sc_sniff * sniff);
+
+/*!
+ * \brief Parse the tapped bytes of one direction
+ *
+ * \param sniff The sniffer
+ * \param dir The direction (0 or 1)
+ * \param data The tapped bytes
+ * \param len The number of the tapped bytes
+ * \param now The arrival time of the bytes
+ */
+void sc_sniff_feed(struct sc_sniff * sniff, uint8_t dir, const unsigned char * data, sc_size_t len,
+        uint32_t now);
+
+/*!
+ * \brief Get a percentile of the response time histogram of a rule
+ *
+ * \param rule The matching rule
+ * \param pct The percentile (0 - 100)
+ *
+ * \return The upper bound of the bucket, which contains the percentile
+ */
+uint32_t sc_sniff_percentile(struct sc_sniff_rule * rule, uint8_t pct);
+
+/*!
+ * \brief Frame callback of the sniffer
+ *
+ * sc_sniff_init() sets it in both parsers.
+ */
+void sc_sniff_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+
@@ -0,0 +1,57 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Per-command statistics
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <string.h>
+
+#include "sercomm_stats.h"
+
+int sc_stats_init(struct sc_stats * stats, struct sercomm * sc, struct sercomm_msg * sm)
+{
+    uint16_t n;
+
+    for (n = 0; sm[n].fn != NULL; n++)
+        ;
+    if (n >= stats->ncmds)
+        return -1;
+    stats->gen = 0;
+    memset(stats->cmds, 0, sizeof(stats->cmds[0]) * stats->ncmds);
+    for (stats->other = 0; stats->other < n; stats->other++)
+        stats->cmds[stats->other].cmd = sm[stats->other].cmd;
+    sc->stats = stats;
+    return 0;
+}
+
+void sc_stats_snapshot(struct sc_stats * stats, struct sc_cmd_stats * out)
+{
+    uint32_t g1, g2;
+
+    do {
+        g1 = __atomic_load_n(&stats->gen, __ATOMIC_ACQUIRE);
+        memcpy(out, stats->cmds, sizeof(out[0]) * stats->ncmds);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        g2 = __atomic_load_n(&stats->gen, __ATOMIC_RELAXED);
+    } while ((g1 & 1) || g1 != g2);
+}
@@ -0,0 +1,181 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Per-command statistics
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_STATS_H
+#define _SERCOMM_STATS_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief Statistics of one command */
+struct sc_cmd_stats {
+	/*! The command (set by sc_stats_init()). Not used in the entry of the other commands */
+	uint32_t		cmd;
+	/*! The number of the received messages */
+	uint32_t		rx_messages;
+	/*! The sum of the received body lengths (the average is rx_bytes / rx_messages) */
+	uint64_t		rx_bytes;
+	/*! The longest received body */
+	uint32_t		rx_max_len;
+	/*! The number of the dropped messages after a valid header (length, FEC, hash, reset). Filtered messages are not counted */
+	uint32_t		rejects;
+	/*! The number of the created messages */
+	uint32_t		tx_messages;
+	/*! The sum of the created message lengths with the header */
+	uint64_t		tx_bytes;
+	/*! The cumulated time of the delivery (frame callback or command callback), in the unit of the clock callback */
+	uint64_t		handler_time;
+};
+
+/*!
+ * \brief Per-command statistics
+ *
+ * It keeps the traffic and timing statistics of each command of a struct sercomm_msg array.
+ * Entry i of the statistics array belongs to sm[i], and the entry at the index of the {0, NULL}
+ * terminator collects the other commands. The parser and the generator update it, if the stats field of struct sercomm
+ * points to it: every received, dropped and created message is counted, so it works with any
+ * frame callback (i.e., the batch or the store module).
+ *
+ * The entries are updated by plain stores on the thread of the parser. Other threads should
+ * read them by sc_stats_snapshot(), which retries, if the copy overlaps an update.
+ *
+ * Example:
+ * \code
+ * static struct sc_cmd_stats cmd_stats[sizeof(sms) / sizeof(sms[0])];
+ * static struct sc_stats stats = {
+ *     .cmds = cmd_stats, .ncmds = sizeof(sms) / sizeof(sms[0]), .clock = cycles,
+ * };
+ *
+ * sc_stats_init(&stats, &sc, sms);
+ * for (i = 0; i < n; i++)
+ *     sc_get_message(&sc, sms, buf[i]);
+ * n = sc_make_message(&sc, MSG_COMMAND_ALARM, 0, body, len, frame, sizeof(frame));
+ * sc_stats_snapshot(&stats, copy);
+ * \endcode
+ */
+struct sc_stats {
+	/*! The statistics array: one entry per struct sercomm_msg entry, with the terminator */
+	struct sc_cmd_stats * cmds;
+	/*! The number of the entries of the statistics array */
+	uint16_t		ncmds;
+	/*! Optional clock callback for the handler time (i.e., a cycle counter). NULL to omit */
+	uint32_t		(* clock)(void);
+	/*! Internal usage: The number of the commands (the index of the entry of the other commands) */
+	uint16_t		other;
+	/*! Internal usage: Update counter (odd, while an entry is updated) */
+	uint32_t		gen;
+};
+
+/*!
+ * \brief Initialize the per-command statistics
+ *
+ * It resets the statistics, takes the commands of sm, and sets the stats field of sc.
+ * The parser keeps its frame callback and priv field.
+ *
+ * \param stats The statistics
+ * \param sc The parser and generator
+ * \param sm The struct sercomm_msg array
+ *
+ * \return Zero on success, or -1 if the statistics array is too small
+ */
+int sc_stats_init(struct sc_stats * stats, struct sercomm * sc, struct sercomm_msg * sm);
+
+/*!
+ * \brief Copy the statistics consistently
+ *
+ * It could be called from any thread.
+ *
+ * \param stats The statistics
+ * \param out Output: ncmds entries
+ */
+void sc_stats_snapshot(struct sc_stats * stats, struct sc_cmd_stats * out);
+
+/* Internal usage: the updates of the parser and the generator (all of the variants) */
+
+static inline struct sc_cmd_stats * sc_stats_entry(struct sc_stats * stats, uint32_t cmd)
+{
+    uint16_t x;
+
+    for (x = 0; x < stats->other; x++) {
+        if (stats->cmds[x].cmd == cmd)
+            break;
+    }
+    return &stats->cmds[x];
+}
+
+//The entries are written by one thread only: the counter marks the updates for the readers
+static inline void sc_stats_begin(struct sc_stats * stats)
+{
+    __atomic_store_n(&stats->gen, stats->gen + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void sc_stats_end(struct sc_stats * stats)
+{
+    __atomic_store_n(&stats->gen, stats->gen + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t sc_stats_clock(struct sc_stats * stats)
+{
+    return stats->clock != NULL ? stats->clock() : 0;
+}
+
+static inline void sc_stats_rx(struct sc_stats * stats, uint32_t cmd, uint32_t mlen, uint32_t t0)
+{
+    struct sc_cmd_stats * s = sc_stats_entry(stats, cmd);
+    uint32_t t = sc_stats_clock(stats) - t0;
+
+    sc_stats_begin(stats);
+    s->rx_messages++;
+    s->rx_bytes += mlen;
+    if (mlen > s->rx_max_len)
+        s->rx_max_len = mlen;
+    s->handler_time += t;
+    sc_stats_end(stats);
+}
+
+static inline void sc_stats_reject(struct sc_stats * stats, uint32_t cmd)
+{
+    struct sc_cmd_stats * s = sc_stats_entry(stats, cmd);
+
+    sc_stats_begin(stats);
+    s->rejects++;
+    sc_stats_end(stats);
+}
+
+static inline void sc_stats_tx(struct sc_stats * stats, uint32_t cmd, uint32_t len)
+{
+    struct sc_cmd_stats * s = sc_stats_entry(stats, cmd);
+
+    sc_stats_begin(stats);
+    s->tx_messages++;
+    s->tx_bytes += len;
+    sc_stats_end(stats);
+}
+
+#endif
+
@@ -0,0 +1,424 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Indexed frame store
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sercomm_store.h"
+
+#define STORE_MAGIC         0x31535453      /* "STS1" */
+#define STORE_PATH_MAX      4096
+#define STORE_REC_SIZE(len) \
+    ((sizeof(struct store_rec) + (len) + 3) & ~(uint32_t)3)
+
+struct store_idx_hdr {
+    uint32_t            magic;
+    uint32_t            block_size;
+    uint32_t            segment_blocks;
+    uint32_t            reserved;
+};
+
+/* Sparse index entry of a block */
+struct store_idx {
+    uint32_t            block;
+    uint32_t            used;           /* The number of bytes in the block */
+    uint32_t            tmin;
+    uint32_t            tmax;
+    uint32_t            count;
+    uint32_t            reserved;
+    uint64_t            ports;          /* Bitmap of port & 63 */
+    uint32_t            cmds[8];        /* Bitmap of cmd & 0xFF */
+};
+
+struct store_rec {
+    uint32_t            mlen;
+    uint32_t            time;
+    uint32_t            cmd;
+    uint32_t            cctrl;
+    uint16_t            port;
+    uint16_t            reserved;
+};
+
+struct store_segment {
+    struct store_idx *  idx;
+    uint32_t            n;
+    uint32_t            size;
+};
+
+struct sc_store {
+    char *              dir;
+    uint32_t            block_size;
+    uint32_t            segment_blocks;
+    struct store_segment * segs;
+    uint32_t            nsegs;
+    int                 seg_fd;         /* The files of the last segment, or -1 */
+    int                 idx_fd;
+    unsigned char *     buf;            /* The current block */
+    struct store_idx    cur;
+    uint64_t            frames;
+    uint64_t            dropped;        /* The frames not stored by sc_store_frame() */
+    uint64_t            blocks;
+    uint64_t            blocks_read;
+    uint64_t            blocks_skipped;
+};
+
+static void store_path(struct sc_store * st, char * path, uint32_t seg, const char * ext)
+{
+    snprintf(path, STORE_PATH_MAX, "%s/%08u.%s", st->dir, seg, ext);
+}
+
+static int store_idx_push(struct store_segment * s, const struct store_idx * e)
+{
+    struct store_idx * idx;
+
+    if (s->n == s->size) {
+        idx = realloc(s->idx, (s->size ? s->size * 2 : 64) * sizeof(*idx));
+        if (idx == NULL)
+            return -1;
+        s->idx = idx;
+        s->size = s->size ? s->size * 2 : 64;
+    }
+    s->idx[s->n++] = *e;
+    return 0;
+}
+
+static struct store_segment * store_seg_add(struct sc_store * st)
+{
+    struct store_segment * segs;
+
+    segs = realloc(st->segs, (st->nsegs + 1) * sizeof(*segs));
+    if (segs == NULL)
+        return NULL;
+    st->segs = segs;
+    memset(&segs[st->nsegs], 0, sizeof(*segs));
+    return &segs[st->nsegs++];
+}
+
+/* Load the index files of an existing store */
+static int store_load(struct sc_store * st)
+{
+    char path[STORE_PATH_MAX];
+    struct store_idx_hdr h;
+    struct store_idx e;
+    struct store_segment * s;
+    int fd;
+
+    for (;;) {
+        store_path(st, path, st->nsegs, "idx");
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return 0;
+        if (read(fd, &h, sizeof(h)) != sizeof(h) || h.magic != STORE_MAGIC) {
+            close(fd);
+            return -1;
+        }
+        st->block_size = h.block_size;
+        st->segment_blocks = h.segment_blocks;
+        s = store_seg_add(st);
+        if (s == NULL) {
+            close(fd);
+            return -1;
+        }
+        //A torn entry at the end is dropped
+        while (read(fd, &e, sizeof(e)) == sizeof(e)) {
+            if (e.block != s->n || e.used > st->block_size || store_idx_push(s, &e) < 0)
+                break;
+            st->frames += e.count;
+            st->blocks++;
+        }
+        close(fd);
+    }
+}
+
+/* Open the files of the last segment, or create a new one, if it is full */
+static int store_seg_open(struct sc_store * st)
+{
+    char path[STORE_PATH_MAX];
+    struct store_idx_hdr h;
+    int flags = O_RDWR | O_CREAT;
+
+    if (st->nsegs == 0 || st->segs[st->nsegs - 1].n >= st->segment_blocks) {
+        if (st->seg_fd >= 0) {
+            close(st->seg_fd);
+            close(st->idx_fd);
+            st->seg_fd = -1;
+        }
+        if (store_seg_add(st) == NULL)
+            return -1;
+        flags |= O_TRUNC;
+    } else if (st->seg_fd >= 0) {
+        return 0;
+    }
+    store_path(st, path, st->nsegs - 1, "seg");
+    st->seg_fd = open(path, flags, 0644);
+    store_path(st, path, st->nsegs - 1, "idx");
+    st->idx_fd = open(path, flags, 0644);
+    if (st->seg_fd < 0 || st->idx_fd < 0)
+        goto error;
+    h.magic = STORE_MAGIC;
+    h.block_size = st->block_size;
+    h.segment_blocks = st->segment_blocks;
+    h.reserved = 0;
+    if (pwrite(st->idx_fd, &h, sizeof(h), 0) != sizeof(h))
+        goto error;
+    return 0;
+
+error:
+    if (st->seg_fd >= 0)
+        close(st->seg_fd);
+    if (st->idx_fd >= 0)
+        close(st->idx_fd);
+    st->seg_fd = -1;
+    st->idx_fd = -1;
+    return -1;
+}
+
+struct sc_store * sc_store_open(const char * dir, uint32_t block_size, uint32_t segment_blocks)
+{
+    struct sc_store * st;
+    long page = sysconf(_SC_PAGESIZE);
+
+    st = calloc(1, sizeof(*st));
+    if (st == NULL)
+        return NULL;
+    st->seg_fd = -1;
+    st->idx_fd = -1;
+    st->block_size = block_size;
+    st->segment_blocks = segment_blocks;
+    st->dir = strdup(dir);
+    if (st->dir == NULL || store_load(st) < 0)
+        goto error;
+    if (st->block_size == 0 || st->block_size % page || st->segment_blocks == 0)
+        goto error;
+    st->buf = malloc(st->block_size);
+    if (st->buf == NULL)
+        goto error;
+    return st;
+
+error:
+    sc_store_close(st);
+    return NULL;
+}
+
+int sc_store_flush(struct sc_store * st)
+{
+    struct store_segment * s;
+    off_t idx_off;
+
+    if (st->cur.used == 0)
+        return 0;
+    if (store_seg_open(st) < 0)
+        return -1;
+    s = &st->segs[st->nsegs - 1];
+    st->cur.block = s->n;
+    idx_off = sizeof(struct store_idx_hdr) + (off_t)s->n * sizeof(struct store_idx);
+    //The block first: the index entry refers to it
+    if (pwrite(st->seg_fd, st->buf, st->cur.used, (off_t)s->n * st->block_size) != (ssize_t)st->cur.used ||
+            pwrite(st->idx_fd, &st->cur, sizeof(st->cur), idx_off) != sizeof(st->cur) ||
+            store_idx_push(s, &st->cur) < 0)
+        return -1;
+    st->blocks++;
+    st->cur.used = 0;
+    return 0;
+}
+
+int sc_store_append(struct sc_store * st, const struct sc_store_record * rec)
+{
+    struct store_rec r;
+    uint32_t size = STORE_REC_SIZE(rec->mlen);
+
+    if (rec->mlen > st->block_size || size > st->block_size)
+        return -1;
+    if (st->cur.used + size > st->block_size && sc_store_flush(st) < 0)
+        return -1;
+    if (st->cur.used == 0) {
+        memset(&st->cur, 0, sizeof(st->cur));
+        st->cur.tmin = UINT32_MAX;
+    }
+
+    r.mlen = rec->mlen;
+    r.time = rec->time;
+    r.cmd = rec->cmd;
+    r.cctrl = rec->cctrl;
+    r.port = rec->port;
+    r.reserved = 0;
+    memcpy(st->buf + st->cur.used, &r, sizeof(r));
+    if (rec->mlen > 0)
+        memcpy(st->buf + st->cur.used + sizeof(r), rec->msg, rec->mlen);
+    st->cur.used += size;
+
+    if (rec->time < st->cur.tmin)
+        st->cur.tmin = rec->time;
+    if (rec->time > st->cur.tmax)
+        st->cur.tmax = rec->time;
+    st->cur.count++;
+    st->cur.ports |= (uint64_t)1 << (rec->port & 63);
+    st->cur.cmds[(rec->cmd & 0xFF) >> 5] |= (uint32_t)1 << (rec->cmd & 31);
+    st->frames++;
+    return 0;
+}
+
+void sc_store_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_store_channel * ch = sc->priv;
+    struct sc_store_record rec;
+
+    rec.port = ch->port;
+    rec.time = sc_frame_ts(sc, f);
+    rec.cmd = f->cmd;
+    rec.cctrl = f->cctrl;
+    rec.mlen = f->mlen;
+    rec.msg = f->msg;
+    if (sc_store_append(ch->store, &rec) < 0)
+        ch->store->dropped++;
+    sc_dispatch(sm, f, ch->priv);
+}
+
+static int store_idx_match(const struct store_idx * e, const struct sc_store_query * q)
+{
+    if (e->count == 0 || e->tmax < q->from || e->tmin > q->to)
+        return 0;
+    if (q->match_cmd && !(e->cmds[(q->cmd & 0xFF) >> 5] & ((uint32_t)1 << (q->cmd & 31))))
+        return 0;
+    if (q->match_port && !(e->ports & ((uint64_t)1 << (q->port & 63))))
+        return 0;
+    return 1;
+}
+
+/* Scan the records of a block. It returns the number of the matches, or -1 to stop */
+static long store_scan(const unsigned char * block, uint32_t used, const struct sc_store_query * q,
+        int (* fn)(const struct sc_store_record * rec, void * priv), void * priv)
+{
+    struct sc_store_record rec;
+    struct store_rec r;
+    uint32_t off = 0;
+    long n = 0;
+
+    while (off + sizeof(r) <= used) {
+        memcpy(&r, block + off, sizeof(r));
+        if (r.mlen > used - off - sizeof(r))
+            break;
+        if (r.time >= q->from && r.time <= q->to && (!q->match_cmd || r.cmd == q->cmd) &&
+                (!q->match_port || r.port == q->port)) {
+            rec.port = r.port;
+            rec.time = r.time;
+            rec.cmd = r.cmd;
+            rec.cctrl = r.cctrl;
+            rec.mlen = r.mlen;
+            rec.msg = block + off + sizeof(r);
+            n++;
+            if (fn(&rec, priv))
+                return -n - 1;
+        }
+        off += STORE_REC_SIZE(r.mlen);
+    }
+    return n;
+}
+
+long sc_store_query(struct sc_store * st, const struct sc_store_query * q,
+        int (* fn)(const struct sc_store_record * rec, void * priv), void * priv)
+{
+    char path[STORE_PATH_MAX];
+    struct store_segment * s;
+    void * block;
+    uint32_t i, b;
+    long total = 0, n;
+    int fd;
+
+    for (i = 0; i < st->nsegs; i++) {
+        s = &st->segs[i];
+        fd = -1;
+        for (b = 0; b < s->n; b++) {
+            if (!store_idx_match(&s->idx[b], q)) {
+                st->blocks_skipped++;
+                continue;
+            }
+            if (fd < 0) {
+                store_path(st, path, i, "seg");
+                fd = open(path, O_RDONLY);
+                if (fd < 0)
+                    return -1;
+            }
+            block = mmap(NULL, st->block_size, PROT_READ, MAP_SHARED, fd, (off_t)b * st->block_size);
+            if (block == MAP_FAILED) {
+                close(fd);
+                return -1;
+            }
+            st->blocks_read++;
+            n = store_scan(block, s->idx[b].used, q, fn, priv);
+            munmap(block, st->block_size);
+            if (n < 0) {
+                close(fd);
+                return total - n - 1;
+            }
+            total += n;
+        }
+        if (fd >= 0)
+            close(fd);
+    }
+
+    //The current block is in the memory
+    if (st->cur.used > 0 && store_idx_match(&st->cur, q)) {
+        n = store_scan(st->buf, st->cur.used, q, fn, priv);
+        total += n < 0 ? -n - 1 : n;
+    }
+    return total;
+}
+
+void sc_store_stats(struct sc_store * st, struct sc_store_stats * s)
+{
+    s->frames = st->frames;
+    s->dropped = st->dropped;
+    s->blocks = st->blocks;
+    s->segments = st->nsegs;
+    s->blocks_read = st->blocks_read;
+    s->blocks_skipped = st->blocks_skipped;
+}
+
+void sc_store_close(struct sc_store * st)
+{
+    uint32_t i;
+
+    if (st == NULL)
+        return;
+    if (st->buf != NULL)
+        sc_store_flush(st);
+    if (st->seg_fd >= 0)
+        close(st->seg_fd);
+    if (st->idx_fd >= 0)
+        close(st->idx_fd);
+    for (i = 0; i < st->nsegs; i++)
+        free(st->segs[i].idx);
+    free(st->segs);
+    free(st->buf);
+    free(st->dir);
+    free(st);
+}
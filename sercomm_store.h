@@ -0,0 +1,194 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Indexed frame store
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_STORE_H
+#define _SERCOMM_STORE_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*!
+ * \brief Indexed store of the received frames (POSIX host only)
+ *
+ * The store appends the validated frames (port, time, command, comm. controll and body) to
+ * segment files in a directory. A segment consists of fixed size blocks. When a block is
+ * full, it is written, and its sparse index entry is appended to the index file of the
+ * segment: the time range, a bitmap of the commands (cmd & 0xFF) and of the ports
+ * (port & 63) of the block. The index is kept in memory too.
+ *
+ * A query checks the index entries, and it maps (mmap()) only the blocks, which could
+ * contain a matching frame. The time of a frame is its Timestamp field (i.e., seconds or
+ * milliseconds), which should be 4 bytes long. The frames could be out of order.
+ *
+ * The current block is written by sc_store_flush() and sc_store_close(), and the next frame
+ * starts a new block. The frames of the current block are lost on a crash. The frame
+ * callback could not report an error: the frames, which could not be stored (i.e., write
+ * error or a too long frame), are counted in the dropped field of struct sc_store_stats.
+ *
+ * Example:
+ * \code
+ * static struct sc_store_channel port7 = { .port = 7 };
+ *
+ * port7.store = sc_store_open("/var/lib/gw/frames", 64 * 1024, 1024);
+ * sc.frame = sc_store_frame;
+ * sc.priv = &port7;
+ * ...
+ * struct sc_store_query q = { .from = t0, .to = t1, .cmd = 0x21, .match_cmd = 1, .port = 7, .match_port = 1 };
+ * sc_store_query(port7.store, &q, print_frame, NULL);
+ * \endcode
+ */
+struct sc_store;
+
+/*! \brief Channel of the store for sc_store_frame() */
+struct sc_store_channel {
+	/*! The store */
+	struct sc_store * store;
+	/*! The port number of the channel */
+	uint16_t		port;
+	/*! Last priv argument of the command callbacks */
+	void *			priv;
+};
+
+/*! \brief A stored frame */
+struct sc_store_record {
+	/*! The port number */
+	uint16_t		port;
+	/*! The Timestamp field */
+	uint32_t		time;
+	/*! Message command value */
+	sc_cmd_t		cmd;
+	/*! The value of the comm. control field */
+	sc_cctrl_t		cctrl;
+	/*! The length of the message body */
+	sc_size_t		mlen;
+	/*! The message body. It is valid only in the query callback */
+	const unsigned char * msg;
+};
+
+/*! \brief Query of the stored frames */
+struct sc_store_query {
+	/*! The first time (inclusive) */
+	uint32_t		from;
+	/*! The last time (inclusive) */
+	uint32_t		to;
+	/*! Message command value */
+	sc_cmd_t		cmd;
+	/*! Non-zero, if the command should match */
+	uint8_t			match_cmd;
+	/*! The port number */
+	uint16_t		port;
+	/*! Non-zero, if the port should match */
+	uint8_t			match_port;
+};
+
+/*! \brief Store statistics */
+struct sc_store_stats {
+	/*! The number of the stored frames */
+	uint64_t		frames;
+	/*! The number of the frames dropped by sc_store_frame(), because they could not be stored */
+	uint64_t		dropped;
+	/*! The number of the written blocks */
+	uint64_t		blocks;
+	/*! The number of the segments */
+	uint32_t		segments;
+	/*! The number of the blocks read by the queries */
+	uint64_t		blocks_read;
+	/*! The number of the blocks skipped by the index */
+	uint64_t		blocks_skipped;
+};
+
+/*!
+ * \brief Open or create a store
+ *
+ * \param dir The directory of the segment files. It should exist
+ * \param block_size The size of the blocks, a multiple of the page size (an existing store keeps its size)
+ * \param segment_blocks The number of the blocks per segment file
+ *
+ * \return The store, or NULL if error occured
+ */
+struct sc_store * sc_store_open(const char * dir, uint32_t block_size, uint32_t segment_blocks);
+
+/*!
+ * \brief Append a frame
+ *
+ * \param st The store
+ * \param rec The frame (the msg field is the body to store)
+ *
+ * \return Zero on success, or -1 if the frame is larger than a block or error occured
+ */
+int sc_store_append(struct sc_store * st, const struct sc_store_record * rec);
+
+/*!
+ * \brief Frame callback, which stores the frame and calls the command callback
+ *
+ * The priv field of struct sercomm should point to a struct sc_store_channel. If the frame
+ * could not be stored, it is counted as dropped (see struct sc_store_stats), and the command
+ * callback is called anyway.
+ */
+void sc_store_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+/*!
+ * \brief Write the current block and its index entry
+ *
+ * \param st The store
+ *
+ * \return Zero on success, or -1 if error occured
+ */
+int sc_store_flush(struct sc_store * st);
+
+/*!
+ * \brief Query the stored frames
+ *
+ * The frames of a block are in append order, the blocks are in store order.
+ *
+ * \param st The store
+ * \param q The query
+ * \param fn The callback of the matching frames. It returns non-zero to stop the query
+ * \param priv Last argument of the callback
+ *
+ * \return The number of the matching frames, or -1 if error occured
+ */
+long sc_store_query(struct sc_store * st, const struct sc_store_query * q,
+        int (* fn)(const struct sc_store_record * rec, void * priv), void * priv);
+
+/*!
+ * \brief Get the statistics of the store
+ *
+ * \param st The store
+ * \param s The output
+ */
+void sc_store_stats(struct sc_store * st, struct sc_store_stats * s);
+
+/*!
+ * \brief Flush and close the store
+ *
+ * \param st The store
+ */
+void sc_store_close(struct sc_store * st);
+
+#endif
+
@@ -0,0 +1,207 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Time synchronization and one-way latency
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <string.h>
+
+#include "sercomm_sync.h"
+#include "sercomm_util.h"
+
+void sc_sync_init(struct sc_sync * sync, struct sercomm * sc)
+{
+    sync->sc = sc;
+    sync->nsamples = 0;
+    sync->next = 0;
+    sync->reply_pending = 0;
+    sync->synced = 0;
+    sync->offset = 0;
+    sync->drift = 0;
+    sync->drift_valid = 0;
+    sync->latency_valid = 0;
+    memset(sync->hist, 0, sizeof(sync->hist));
+    sync->hist_negative = 0;
+    sync->latency_min = INT32_MAX;
+    sync->latency_max = INT32_MIN;
+    sync->latency_sum = 0;
+    sync->latency_count = 0;
+    sync->tx_probes = 0;
+    sync->rx_replies = 0;
+    sc->frame = sc_sync_frame;
+    sc->priv = sync;
+}
+
+sc_size_t sc_sync_probe(struct sc_sync * sync, unsigned char * output, sc_size_t olen)
+{
+    struct sercomm * sc = sync->sc;
+    uint32_t t1 = sync->now();
+    unsigned char body[4];
+    sc_size_t n;
+
+    memcpy(body, &t1, 4);
+    n = sc_make_message_ts(sc, sync->probe_cmd, 0, t1 & sc_ts_mask(sc), body, sizeof(body), output, olen);
+    if (n > 0)
+        sync->tx_probes++;
+    return n;
+}
+
+sc_size_t sc_sync_next(struct sc_sync * sync, unsigned char * output, sc_size_t olen)
+{
+    struct sercomm * sc = sync->sc;
+    unsigned char body[12];
+    uint32_t t3;
+    sc_size_t n;
+
+    if (!sync->reply_pending)
+        return 0;
+    t3 = sync->now();
+    memcpy(&body[0], &sync->reply_t1, 4);
+    memcpy(&body[4], &sync->reply_t2, 4);
+    memcpy(&body[8], &t3, 4);
+    n = sc_make_message_ts(sc, sync->reply_cmd, 0, t3 & sc_ts_mask(sc),
+            body, sizeof(body), output, olen);
+    if (n > 0)
+        sync->reply_pending = 0;
+    return n;
+}
+
+static int32_t sync_offset_at(struct sc_sync * sync, uint32_t local)
+{
+    int64_t dt = (int32_t)(local - sync->ref_time);
+
+    if (!sync->drift_valid)
+        return sync->offset;
+    return sync->offset + (int32_t)(dt * sync->drift / 1000000000);
+}
+
+uint32_t sc_sync_to_peer(struct sc_sync * sync, uint32_t local)
+{
+    if (!sync->synced)
+        return local;
+    return local + (uint32_t)sync_offset_at(sync, local);
+}
+
+/* Clock filter: the offset of the sample with the smallest delay */
+static void sync_update(struct sc_sync * sync)
+{
+    struct sc_sync_sample * best = &sync->samples[0];
+    int64_t est;
+    int32_t dt;
+    uint8_t i;
+
+    for (i = 1; i < sync->nsamples; i++) {
+        if (sync->samples[i].delay < best->delay)
+            best = &sync->samples[i];
+    }
+    if (!sync->synced) {
+        sync->offset = best->offset;
+        sync->ref_time = best->time;
+        sync->synced = 1;
+        return;
+    }
+    //Only a newer best sample gives new information
+    dt = (int32_t)(best->time - sync->ref_time);
+    if (dt <= 0)
+        return;
+    est = ((int64_t)best->offset - sync->offset) * 1000000000 / dt;
+    if (!sync->drift_valid) {
+        sync->drift = (int32_t)est;
+        sync->drift_valid = 1;
+    } else {
+        sync->drift += (int32_t)((est - sync->drift) / 4);
+    }
+    sync->offset = best->offset;
+    sync->ref_time = best->time;
+}
+
+static void sync_reply(struct sc_sync * sync, const unsigned char * msg, uint32_t t4)
+{
+    struct sc_sync_sample * s;
+    uint32_t t1, t2, t3;
+    int32_t delay;
+
+    memcpy(&t1, &msg[0], 4);
+    memcpy(&t2, &msg[4], 4);
+    memcpy(&t3, &msg[8], 4);
+    delay = (int32_t)((t4 - t1) - (t3 - t2));
+
+    s = &sync->samples[sync->next];
+    s->offset = (int32_t)(((int64_t)(int32_t)(t2 - t1) + (int32_t)(t3 - t4)) / 2);
+    s->delay = delay > 0 ? (uint32_t)delay : 0;
+    s->time = t4;
+    sync->next = (sync->next + 1) % SC_SYNC_SAMPLES;
+    if (sync->nsamples < SC_SYNC_SAMPLES)
+        sync->nsamples++;
+    sync->rx_replies++;
+    sync_update(sync);
+}
+
+static void sync_account(struct sc_sync * sync, int32_t latency)
+{
+    if (latency < 0)
+        sync->hist_negative++;
+    else
+        sc_hist_add(sync->hist, SC_SYNC_HIST_BUCKETS, (uint32_t)latency);
+    if (latency < sync->latency_min)
+        sync->latency_min = latency;
+    if (latency > sync->latency_max)
+        sync->latency_max = latency;
+    sync->latency_sum += latency;
+    sync->latency_count++;
+}
+
+uint32_t sc_sync_percentile(struct sc_sync * sync, uint8_t pct)
+{
+    return sc_hist_percentile(sync->hist, SC_SYNC_HIST_BUCKETS, sync->hist_negative, pct);
+}
+
+void sc_sync_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_sync * sync = sc->priv;
+    uint32_t now = sync->now(), mask = sc_ts_mask(sc), lat;
+
+    if (f->cmd == sync->probe_cmd && f->mlen == 4) {
+        memcpy(&sync->reply_t1, f->msg, 4);
+        sync->reply_t2 = now;
+        sync->reply_pending = 1;
+        return;
+    }
+    if (f->cmd == sync->reply_cmd && f->mlen == 12) {
+        sync_reply(sync, f->msg, now);
+        return;
+    }
+
+    if (sync->synced && sc->ts_bytes > 0) {
+        lat = (sc_sync_to_peer(sync, now) - sc_frame_ts(sc, f)) & mask;
+        //Sign extension from the width of the Timestamp field
+        if (mask != UINT32_MAX && lat > mask / 2)
+            sync->latency = -(int32_t)(mask - lat) - 1;
+        else
+            sync->latency = (int32_t)lat;
+        sync->latency_valid = 1;
+        sync_account(sync, sync->latency);
+    }
+    sc_dispatch(sm, f, sync->priv != NULL ? sync->priv : sync);
+    sync->latency_valid = 0;
+}
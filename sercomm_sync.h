@@ -0,0 +1,210 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Time synchronization and one-way latency
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_SYNC_H
+#define _SERCOMM_SYNC_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief The number of the probe samples in the clock filter */
+#define SC_SYNC_SAMPLES						8
+/*! \brief The number of the latency histogram buckets */
+#define SC_SYNC_HIST_BUCKETS				24
+
+/*! \brief Probe sample */
+struct sc_sync_sample {
+	/*! The clock offset (peer - local) measured by the probe */
+	int32_t			offset;
+	/*! The round trip delay without the processing time of the peer */
+	uint32_t		delay;
+	/*! The local time of the reception of the reply */
+	uint32_t		time;
+};
+
+/*!
+ * \brief Time synchronization and one-way latency estimation
+ *
+ * The two peers exchange probe messages in the style of NTP. The probe carries the local send
+ * time (t1). The peer answers with t1, its receive time (t2) and its send time (t3). At the
+ * receive time of the reply (t4):
+ * \code
+ * offset = ((t2 - t1) + (t3 - t4)) / 2
+ * delay  = (t4 - t1) - (t3 - t2)
+ * \endcode
+ * The clock filter keeps the last SC_SYNC_SAMPLES samples, and it uses the offset of the
+ * sample with the smallest delay: the queueing delay makes the path asymmetric, so the
+ * fastest exchange gives the most accurate offset. The drift is estimated from the offsets of
+ * consecutive best samples, and it is smoothed exponentially.
+ *
+ * Every other message is annotated with its one-way latency: the arrival time converted to the
+ * clock of the peer, minus the Timestamp field. Therefore the ts callback of the peer should
+ * write the same clock as its now callback, truncated to the Timestamp field (1, 2 or 4 bytes).
+ * The latency is in the latency field during the command callback, and it is added to the
+ * latency histogram of the channel (struct sercomm). Leave the priv field NULL to get the
+ * struct sc_sync in the command callbacks:
+ * \code
+ * static void log_cb(unsigned char * ts, sc_size_t mlen, unsigned char * msg, sc_cctrl_t cctrl, void * priv)
+ * {
+ *     struct sc_sync * sync = priv;
+ *
+ *     if (sync->latency_valid)
+ *         printf("latency %d us\n", (int)sync->latency);
+ * }
+ * \endcode
+ *
+ * The library does not send the replies by itself: sc_sync_next() gives the pending reply.
+ *
+ * Example:
+ * \code
+ * static struct sc_sync sync = { .probe_cmd = MSG_COMMAND_PROBE, .reply_cmd = MSG_COMMAND_PROBE_REPLY, .now = now_us };
+ *
+ * sc_sync_init(&sync, &sc);
+ * n = sc_sync_probe(&sync, frame, sizeof(frame));     // periodically
+ * uart_send(frame, n);
+ * ...
+ * sc_get_message(&sc, sms, byte);
+ * n = sc_sync_next(&sync, frame, sizeof(frame));      // after the parsing
+ * if (n > 0)
+ *     uart_send(frame, n);
+ * \endcode
+ */
+struct sc_sync {
+	/*! The parser of the channel */
+	struct sercomm * sc;
+	/*! Last priv argument of the command callbacks. If it is NULL, they get the struct sc_sync */
+	void *			priv;
+	/*! Command value of the probe */
+	sc_cmd_t		probe_cmd;
+	/*! Command value of the probe reply */
+	sc_cmd_t		reply_cmd;
+	/*! Local clock callback (i.e., microseconds). Both peers should use the same unit */
+	uint32_t		(* now)(void);
+	/*! Internal usage: The probe samples (circular) */
+	struct sc_sync_sample samples[SC_SYNC_SAMPLES];
+	/*! Internal usage: The number of the valid samples */
+	uint8_t			nsamples;
+	/*! Internal usage: The next sample to overwrite */
+	uint8_t			next;
+	/*! Internal usage: A reply is pending */
+	uint8_t			reply_pending;
+	/*! Internal usage: t1 and t2 of the pending reply */
+	uint32_t		reply_t1, reply_t2;
+	/*! Non-zero, if the offset is estimated */
+	uint8_t			synced;
+	/*! The estimated clock offset (peer - local) at ref_time */
+	int32_t			offset;
+	/*! The local time of the last offset estimation */
+	uint32_t		ref_time;
+	/*! The estimated drift of the peer clock in parts per billion */
+	int32_t			drift;
+	/*! Non-zero, if the drift is estimated */
+	uint8_t			drift_valid;
+	/*! The one-way latency of the message under the command callback (in the clock unit) */
+	int32_t			latency;
+	/*! Non-zero, if the latency field is valid */
+	uint8_t			latency_valid;
+	/*! Latency histogram: bucket 0 is zero, bucket i is [2^(i-1), 2^i), the last one is open */
+	uint32_t		hist[SC_SYNC_HIST_BUCKETS];
+	/*! Statistics: The number of the negative latencies (offset estimation error) */
+	uint32_t		hist_negative;
+	/*! Statistics: The smallest latency */
+	int32_t			latency_min;
+	/*! Statistics: The largest latency */
+	int32_t			latency_max;
+	/*! Statistics: The sum of the latencies */
+	int64_t			latency_sum;
+	/*! Statistics: The number of the measured latencies */
+	uint32_t		latency_count;
+	/*! Statistics: The number of the sent probes */
+	uint32_t		tx_probes;
+	/*! Statistics: The number of the received replies */
+	uint32_t		rx_replies;
+};
+
+/*!
+ * \brief Initialize the time synchronization
+ *
+ * It resets the estimation and the statistics, and sets the frame callback and the priv
+ * field of sc.
+ *
+ * \param sync The time synchronization
+ * \param sc The parser of the channel
+ */
+void sc_sync_init(struct sc_sync * sync, struct sercomm * sc);
+
+/*!
+ * \brief Create a probe message
+ *
+ * \param sync The time synchronization
+ * \param output The output buffer
+ * \param olen The size of the output buffer
+ *
+ * \return The length of the message with the header, or zero if error occured
+ */
+sc_size_t sc_sync_probe(struct sc_sync * sync, unsigned char * output, sc_size_t olen);
+
+/*!
+ * \brief Create the pending probe reply
+ *
+ * \param sync The time synchronization
+ * \param output The output buffer
+ * \param olen The size of the output buffer
+ *
+ * \return The length of the message with the header, or zero if there is no pending reply
+ */
+sc_size_t sc_sync_next(struct sc_sync * sync, unsigned char * output, sc_size_t olen);
+
+/*!
+ * \brief Convert a local time to the clock of the peer
+ *
+ * \param sync The time synchronization
+ * \param local The local time
+ *
+ * \return The time in the clock of the peer (local, if the offset is not estimated)
+ */
+uint32_t sc_sync_to_peer(struct sc_sync * sync, uint32_t local);
+
+/*!
+ * \brief Get a percentile of the latency histogram
+ *
+ * \param sync The time synchronization
+ * \param pct The percentile (0 - 100)
+ *
+ * \return The upper bound of the bucket, which contains the percentile
+ */
+uint32_t sc_sync_percentile(struct sc_sync * sync, uint8_t pct);
+
+/*!
+ * \brief Frame callback of the time synchronization
+ *
+ * sc_sync_init() sets it in the struct sercomm of the channel.
+ */
+void sc_sync_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+
@@ -0,0 +1,374 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Size type template of the parser and the generator
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+/*
+ * This file is a template: it declares the structs and the functions of the parser and the
+ * generator over the size types. It has no include guard, and it is included by sercomm.h
+ * (the default variant) and by the size type variants (i.e., sercomm8.h) with these macros:
+ *
+ * SC_T_NAME(name)  The name of a struct or a function of the variant (i.e., name##8)
+ * SC_T_SIZE        The length type (sc_size_t)
+ * SC_T_CMD         The command type (sc_cmd_t)
+ * SC_T_CCTRL       The comm. controll type (sc_cctrl_t)
+ *
+ * The macros are undefined at the end. sercomm_tmpl_impl.h is the implementation template.
+ */
+
+#include <inttypes.h>
+#include <stddef.h>         /* for offsetof */
+
+struct sercomm_filter;
+struct sercomm_fec;
+struct sercomm_crcfix;
+struct SC_T_NAME(sercomm_msg);
+struct SC_T_NAME(sercomm_frame);
+struct SC_T_NAME(sercomm_spec);
+
+/*!
+ * \brief Sercomm configuration
+ *
+ * This struct sets the header configuration of the serial messages, and
+ * it is used for internal storage, while parsing messages.
+ *
+ * To use tiny use (smaller struct sercomm size) define SERCOMM_USE_TINY_SC, or use the size
+ * type variants of sercomm8.h and sercomm16.h!
+ *
+ * Example:
+ * \code
+ * static unsigned char comm_buffer[COMM_BUFFER_SIZE];
+ * static struct sercomm sc = {
+ *     .frame_start = { 0x00, 0x01, 0x02, 0x03 },
+ *     .frame_start_bytes = 4,
+ *     .cmd_bytes = 1,
+ *     .ts_bytes = 4,
+ *     .ts = add_timestamp,
+ *     .len_bytes = 1,
+ *     .hash_bytes = 32,
+ *     .hash = gen_crc_hash,
+ *     .comm_ctrl_bytes = 1,
+ *     .message_max_len = 8,
+ *     .message_valid_len = 8,
+ *     .reset_byte = 0xFF,
+ *     .reset_bytes = 51,
+ *     .reset = do_reset,
+ *     .buffer = comm_buffer,
+ *     .buffer_size = COMM_BUFFER_SIZE,
+ * };
+ * \endcode
+ *
+ * <b>Message format:</b>
+ * \code
+ * +----------------+--------------+
+ * |                |              |
+ * | Sercomm header | Message body |
+ * |                |              |
+ * +----------------+--------------+
+ * \endcode
+ * The deatils of the Sercomm header are below.
+ *
+ * <b>Sercomm header format:</b>
+ * \code
+ * +-------------+---------+-----------+----------------+----------------+------+
+ * |             |         |           |                |                |      |
+ * | Frame start | Command | Timestamp | Message length | Comm. controll | Hash |
+ * |             |         |           |                |                |      |
+ * +-------------+---------+-----------+----------------+----------------+------+
+ * \endcode
+ * - Frame start: Start sequency
+ * - Command: Message type / Command code
+ * - Timestamp: Message timestamp or sequence number (optional)
+ * - Message length: The length of the message without the header
+ * - Communication controll: Additional comm. controll command, i.e., Close connection (optional)
+ * - Hash: Hash or integrity check, i.e., CRC
+ *
+ * Before the hash generation, the hash field is be zero!
+ *
+ * <b>Minimal Sercomm header format with only the required fields:</b>
+ * \code
+ * +-------------+---------+----------------+----------------+
+ * |             |         |                |                |
+ * | Frame start | Command | Message length | Comm. controll |
+ * |             |         |                |                |
+ * +-------------+---------+----------------+----------------+
+ * \endcode 
+ */
+struct SC_T_NAME(sercomm) {
+	/* The length of the Command field (number of bytes). */
+	uint8_t			cmd_bytes;
+	/*! The length of the Timestamp field (number of bytes). Zero to omit. */
+	uint8_t			ts_bytes;
+	/*! Timestamp callback: ts arguments points to the beginning of the Timestamp field. */
+	void            (* ts)(void * ts);
+	/*! The length of the Message length field (number of bytes). */
+	uint8_t			len_bytes;
+	/*! The length of the Hash field (number of bytes). Zero to omit. */
+	uint8_t			hash_bytes;
+	/*! Hash callback: hashptr points to the beginning of the Hash field, msg and mlen are the message and its length */
+    void            (* hash)(unsigned char * hashptr, unsigned char * msg, int mlen);
+	/*! The length of the communication controll field (number of bytes). Zero to omit. */
+    uint8_t         comm_ctrl_bytes;
+	/*! The length of the frame start field (number of bytes). */
+	uint8_t 		frame_start_bytes;
+	/*! The reset byte. A sequence of reset_bytes number of it will be call the reset function */
+    unsigned char   reset_byte;
+	/*! The number of the reset_byte byte. A sequence of reset_bytes number of reset_byte will be call the reset function */
+    uint8_t         reset_bytes;
+	/*! Reset callback. It will be called if a reset sequence received. It could be use to reset any message processing mechanisms */
+	void            (* reset)(void);
+	/*! Buffer. It should to be an enogh big array. Use an array which could store at least two messages */
+    unsigned char * buffer;
+	/*! The size of the Buffer */
+    SC_T_SIZE       buffer_size;
+	/*! For message validition: If all of the messages have he same size, use it instead of message_max_len. To ommit this check: SERCOMM_IGNORE_MSG_VALID_LENGTH */
+    SC_T_SIZE		message_valid_len;
+	/*! For message validation: The maximum length of a message (without the header). */
+	SC_T_SIZE		message_max_len;
+	/*! Header filter (see sercomm_filter.h). Frames not matching it are skipped without buffering. NULL to omit. */
+	const struct sercomm_filter * filter;
+	/*! Forward error correction (see sercomm_fec.h). NULL to omit. */
+	struct sercomm_fec * fec;
+	/*! CRC syndrome based error correction (see sercomm_crc.h). NULL to omit. */
+	struct sercomm_crcfix * crcfix;
+	/*! Speculative processing of the commands (see struct sercomm_spec). NULL to omit. */
+	const struct SC_T_NAME(sercomm_spec) * spec;
+	/*! Frame callback: if set, it is called with every validated message instead of the command lookup. See sc_dispatch() */
+	void            (* frame)(struct SC_T_NAME(sercomm) * sc, struct SC_T_NAME(sercomm_msg) * sm, struct SC_T_NAME(sercomm_frame) * f);
+	/*! Last priv argument of command callback (fn) in struct sercomm_msg */
+    void *          priv;
+	/*! Per-command statistics (see sercomm_stats.h). NULL to omit. */
+	struct sc_stats * stats;
+	/*! Internal usage: The current number of bytes in the buffer */
+    SC_T_SIZE       buffer_len;
+	/*! Internal usge: The message (body) length of the currently parsed message */
+    SC_T_SIZE       message_len;
+	/*! Internal usage: The number of the received reset bytes */
+	uint8_t         buffer_reset_bytes;
+	/*! Internal usage: The header of the current message is validated */
+	uint8_t         header_done;
+	/*! Internal usage: The number of bytes to skip of a filtered message */
+    SC_T_SIZE       skip_len;
+	/*! Internal usage: The filter result of the current message depends on the Comm. controll field */
+	uint8_t         filter_pending;
+	/*! Internal usage: The entry of spec of the speculated message, or NULL */
+	const struct SC_T_NAME(sercomm_spec) * spec_pending;
+	/*! Array of the frame start bytes. See the example */
+	unsigned char   frame_start[];
+};
+
+
+/*!
+ * \brief Sercomm message and command definition
+ *
+ * Use this struct to define each message commands and their parser functions.
+ * If a message successfully received and validated the fn callbacck will be called for further processing.
+ *
+ * The last entry of the array should to be {0, NULL}!
+ *
+ * Example usage:
+ * \code
+ * static struct sercomm_msg sms[] = {
+ *		{ MSG_COMMAND_PRESENT,		cmd_present },
+ *		{ MSG_COMMAND_ALARM,		cmd_alarm },
+ *		{ MSG_COMMAND_CALIBRATE,	cmd_calibrate },
+ *		{ MSG_COMMAND_ALARM_CLEAR,	cmd_alarm_clear },
+ *		{ MSG_COMMAND_VALIDATE_COMM,cmd_validate_comm },
+ *		{ MSG_COMMAND_BEEP,			cmd_do_beep },
+ *		{ MSG_COMMAND_ACK1,			cmd_ack1 },
+ *		{ MSG_COMMAND_ACK2,			cmd_ack2 },
+ *		{ 0,        NULL }
+ * };
+ * \endcode
+ */
+struct SC_T_NAME(sercomm_msg) {
+	/*! Message command value */
+	SC_T_CMD 		cmd;
+	/*! 
+	 * Processing callback. The first argument is the beginning of the timestamp field; the second is the message length;
+	 * the third is the beginning of the message; the fourth is the value of the comm. control field;
+	 * and the last is the priv field of struct sercomm
+	 */
+    void            (* fn)(unsigned char * ts, SC_T_SIZE mlen, unsigned char * msg, SC_T_CCTRL comm_ctrl, void * priv);
+};
+
+/*!
+ * \brief Parsed message descriptor
+ *
+ * It describes a validated message for the frame callback of struct sercomm. The pointers
+ * point into the buffer of struct sercomm, so they are valid only until the callback returns.
+ */
+struct SC_T_NAME(sercomm_frame) {
+	/*! The beginning of the Timestamp field */
+	unsigned char * ts;
+	/*! Message command value */
+	SC_T_CMD		cmd;
+	/*! The length of the message body */
+	SC_T_SIZE		mlen;
+	/*! The beginning of the message body */
+	unsigned char * msg;
+	/*! The value of the comm. control field */
+	SC_T_CCTRL		cctrl;
+};
+
+/*!
+ * \brief Speculative processing of a command
+ *
+ * The speculate callback is called as soon as the body of the message is received, before
+ * the Hash and Comm. controll fields arrive, so the work (i.e., pre-positioning an actuator)
+ * overlaps with the reception of the trailer. After the hash verification, either the commit
+ * callback is called and the message is processed as usual (frame or command callback), or the
+ * abort callback is called and the message is dropped. A message is aborted by a wrong hash,
+ * by the header filter (on the Comm. controll field), or by the reset sequence.
+ *
+ * The cctrl field of the frame is zero in the speculate callback. If the message is repaired
+ * by the CRC error correction, the commit callback gets the repaired body. Speculation needs
+ * a Hash field, and it is not used with FEC (the body is corrected only at the end).
+ *
+ * The last entry of the array should to be {0, NULL}!
+ *
+ * Example:
+ * \code
+ * static const struct sercomm_spec specs[] = {
+ *     { MSG_COMMAND_MOVE, move_prepare, move_commit, move_abort },
+ *     { 0, NULL }
+ * };
+ *
+ * sc.spec = specs;
+ * \endcode
+ */
+struct SC_T_NAME(sercomm_spec) {
+	/*! Message command value */
+	SC_T_CMD		cmd;
+	/*! Speculate callback: the body of the message is received */
+	void			(* speculate)(struct SC_T_NAME(sercomm_frame) * f, void * priv);
+	/*! Commit callback (optional): the hash of the speculated message is verified */
+	void			(* commit)(struct SC_T_NAME(sercomm_frame) * f, void * priv);
+	/*! Abort callback (optional): the speculated message is dropped */
+	void			(* abort)(struct SC_T_NAME(sercomm_frame) * f, void * priv);
+};
+
+/*!
+ * \brief Create a message with sercomm header
+ *
+ * This function cretates a message with proper header configuration.
+ * After return the message is ready for sending.
+ *
+ * Example usage:
+ * \code
+ * uint8_t tmp;
+ * tmp = sc_make_message(&sc, MSG_COMMAND_ALARM, MSG_CCTRL_NONE, message_body, message_body_len, comm_buffer, COMM_BUFFER_SIZE);
+ * uart_send_message(comm_buffer, tmp);
+ * \endcode
+ *
+ * \param sercomm The main struct sercom
+ * \param cmd Message command value
+ * \param cctrl The value of the comm. control field
+ * \param msg Message body
+ * \param mlen The length of the message body
+ * \param output The output buffer. The message with the header will be generated here.
+ * \param olen The size of the output buffer
+ *
+ * \return The length of the message with the header, or zero if error occured
+ */
+SC_T_SIZE SC_T_NAME(sc_make_message)(struct SC_T_NAME(sercomm) * sc, SC_T_CMD cmd, SC_T_CCTRL cctrl,
+        unsigned char * msg, SC_T_SIZE mlen,
+        unsigned char * output, SC_T_SIZE olen);
+
+/*!
+ * \brief Create a message with sercomm header and a given Timestamp field
+ *
+ * It is the same as sc_make_message(), but the Timestamp field is set to ts instead of
+ * calling the ts callback of struct sercomm. Use it, if the field carries a sequence number.
+ * The Timestamp field should be 1, 2 or 4 bytes long.
+ *
+ * \param sc The main struct sercom
+ * \param cmd Message command value
+ * \param cctrl The value of the comm. control field
+ * \param ts The value of the Timestamp field
+ * \param msg Message body
+ * \param mlen The length of the message body
+ * \param output The output buffer. The message with the header will be generated here.
+ * \param olen The size of the output buffer
+ *
+ * \return The length of the message with the header, or zero if error occured
+ */
+SC_T_SIZE SC_T_NAME(sc_make_message_ts)(struct SC_T_NAME(sercomm) * sc, SC_T_CMD cmd, SC_T_CCTRL cctrl,
+        uint32_t ts, unsigned char * msg, SC_T_SIZE mlen,
+        unsigned char * output, SC_T_SIZE olen);
+
+/*!
+ * \brief Get and parse a message
+ *
+ * This function gets the message byte to byte. It build the entire message from the received bytes.
+ * If the message is valid, it calls the callback of the command.
+ *
+ * It searches the beginng of the message. It shoudl to be the frame start sequence.
+ * The first validation will be proceeded after the receiving of the message hader. 
+ * The next, after the receiving of the full message.
+ *
+ * Example:
+ * \code
+ * static void main_get_message(uint8_t byte)
+ * {
+ *		sc_get_message(&sc, sms, byte);
+ * }
+ * \endcode
+ *
+ * \param sc The main struct sercomm
+ * \param sm The struct sercomm_msg array
+ * \param byte The received byte
+ */
+void SC_T_NAME(sc_get_message)(struct SC_T_NAME(sercomm) * sc, struct SC_T_NAME(sercomm_msg) * sm, 
+        unsigned char byte);
+
+/*!
+ * \brief Call the command callback of a parsed message
+ *
+ * It searches the command of the message in the struct sercomm_msg array, and calls its callback.
+ * sc_get_message() does the same, if no frame callback is set in struct sercomm.
+ * Frame callbacks could use it to pass the message for the normal processing.
+ *
+ * \param sm The struct sercomm_msg array
+ * \param f The parsed message
+ * \param priv Last argument of the command callback
+ *
+ * \return Non-zero if a command callback is called
+ */
+int SC_T_NAME(sc_dispatch)(struct SC_T_NAME(sercomm_msg) * sm, struct SC_T_NAME(sercomm_frame) * f, void * priv);
+
+/*!
+ * \brief Get the value of the Timestamp field of a parsed message
+ *
+ * \param sc The main struct sercomm
+ * \param f The parsed message
+ *
+ * \return The value of the field, or zero if it is not 1, 2 or 4 bytes long
+ */
+uint32_t SC_T_NAME(sc_frame_ts)(struct SC_T_NAME(sercomm) * sc, struct SC_T_NAME(sercomm_frame) * f);
+
+#undef SC_T_NAME
+#undef SC_T_SIZE
+#undef SC_T_CMD
+#undef SC_T_CCTRL
+
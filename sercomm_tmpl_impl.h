@@ -0,0 +1,448 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Size type template of the parser and the generator: implementation
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+/*
+ * This file is the implementation template of sercomm_tmpl.h. It is included by sercomm.c
+ * (the default variant) and by the size type variants (i.e., sercomm8.c) after sercomm.h,
+ * sercomm_filter.h, sercomm_fec.h, sercomm_crc.h, sercomm_stats.h and the header of the
+ * variant, with the macros of sercomm_tmpl.h and these:
+ *
+ * SC_T_IGNORE      The value of SERCOMM_IGNORE_MSG_VALID_LENGTH in the variant
+ *
+ * The macros are undefined at the end.
+ */
+
+#include <string.h>
+
+#ifndef _SERCOMM_TMPL_FIELDS
+#define _SERCOMM_TMPL_FIELDS
+
+static void put_field(unsigned char * dst, uint32_t src, uint8_t len)
+{
+    switch (len) {
+        case 1:
+            *(uint8_t *)dst = (uint8_t)src;
+            break;
+        case 2:
+            *(uint16_t *)dst = (uint16_t)src;
+            break;
+        case 4:
+            *(uint32_t *)dst = (uint32_t)src;
+            break;
+        //default:
+            //error
+    }
+}
+
+static void get_field(uint32_t * dst, unsigned char * src, uint8_t len)
+{
+    switch (len) {
+        case 1:
+            *dst = *(uint8_t *)src;
+            break;
+        case 2:
+            *dst = *(uint16_t *)src;
+            break;
+        case 4:
+            *dst = *(uint32_t *)src;
+            break;
+        //default:
+            //error
+    }
+}
+
+#endif
+
+static SC_T_SIZE SC_T_NAME(make_message)(struct SC_T_NAME(sercomm) * sc, SC_T_CMD cmd, SC_T_CCTRL cctrl,
+        const uint32_t * ts, unsigned char * msg, SC_T_SIZE mlen,
+        unsigned char * output, SC_T_SIZE olen)
+{
+    //The lengths are computed in 32 bits, so a too long message could not wrap around
+    uint32_t x, sumlen, hashlen, tail, hp = 0, bp = 0;
+
+    sumlen = 
+        sc->frame_start_bytes +
+        sc->cmd_bytes +
+        sc->ts_bytes +
+        sc->len_bytes +
+        mlen +
+        sc->hash_bytes +
+        sc->comm_ctrl_bytes;
+    tail = mlen + sc->hash_bytes + sc->comm_ctrl_bytes;
+    if (sc->fec != NULL) {
+        hp = SC_FEC_PARITY_LEN(sc->fec->k, sumlen - sc->frame_start_bytes - tail, sc->fec->nsym_hdr);
+        bp = SC_FEC_PARITY_LEN(sc->fec->k, tail, sc->fec->nsym);
+    }
+
+    if (sumlen + hp + bp > olen)
+		return 0;
+	if (mlen > 0 && msg == NULL)
+        return 0;
+
+    if (sc->frame_start_bytes > 0)
+        memcpy(output, sc->frame_start, sc->frame_start_bytes);
+    x = sc->frame_start_bytes;
+    put_field(&output[x], cmd, sc->cmd_bytes);
+    x += sc->cmd_bytes;
+    if (ts != NULL)
+        put_field(&output[x], *ts, sc->ts_bytes);
+    else if (sc->ts_bytes > 0 && sc->ts != NULL)
+        sc->ts(&output[x]);
+    x += sc->ts_bytes;
+    put_field(&output[x], mlen, sc->len_bytes);
+    x += sc->len_bytes;
+    memcpy(&output[x], msg, mlen);
+    x += mlen;
+    if (sc->hash_bytes > 0)
+        memset(&output[x], 0, sc->hash_bytes);
+    x += sc->hash_bytes;
+	if (sc->comm_ctrl_bytes > 0)
+	    put_field(&output[x], cctrl, sc->comm_ctrl_bytes);
+    x -= sc->hash_bytes;
+    hashlen = 
+        sc->cmd_bytes +
+        sc->ts_bytes +
+        sc->len_bytes +
+        mlen;
+    if (sc->hash_bytes > 0 && sc->hash != NULL)
+        sc->hash(&output[x], &output[sc->frame_start_bytes], hashlen); 
+
+    if (sc->fec != NULL) {
+        //Make room for the header parity, then protect the header and the rest separately
+        x = sc->frame_start_bytes + hashlen - mlen;
+        memmove(&output[x + hp], &output[x], tail);
+        if (hp > 0)
+            sc->fec->encode(sc->fec, &output[sc->frame_start_bytes], hashlen - mlen,
+                    sc->fec->nsym_hdr, &output[x]);
+        if (bp > 0)
+            sc->fec->encode(sc->fec, &output[x + hp], tail, sc->fec->nsym, &output[x + hp + tail]);
+        sumlen += hp + bp;
+    }
+    if (sc->stats != NULL)
+        sc_stats_tx(sc->stats, cmd, sumlen);
+
+    return (SC_T_SIZE)sumlen;
+}
+
+SC_T_SIZE SC_T_NAME(sc_make_message)(struct SC_T_NAME(sercomm) * sc, SC_T_CMD cmd, SC_T_CCTRL cctrl,
+        unsigned char * msg, SC_T_SIZE mlen,
+        unsigned char * output, SC_T_SIZE olen)
+{
+    return SC_T_NAME(make_message)(sc, cmd, cctrl, NULL, msg, mlen, output, olen);
+}
+
+SC_T_SIZE SC_T_NAME(sc_make_message_ts)(struct SC_T_NAME(sercomm) * sc, SC_T_CMD cmd, SC_T_CCTRL cctrl,
+        uint32_t ts, unsigned char * msg, SC_T_SIZE mlen,
+        unsigned char * output, SC_T_SIZE olen)
+{
+    return SC_T_NAME(make_message)(sc, cmd, cctrl, &ts, msg, mlen, output, olen);
+}
+
+static void SC_T_NAME(shift_message)(struct SC_T_NAME(sercomm) * sc, uint8_t offset, uint8_t amount)
+{
+    int i;
+
+    for (i = offset; i < amount + offset; i++) {
+        sc->buffer[i - offset] = sc->buffer[i];
+    }
+    sc->buffer_len -= offset;
+}
+
+int SC_T_NAME(sc_dispatch)(struct SC_T_NAME(sercomm_msg) * sm, struct SC_T_NAME(sercomm_frame) * f, void * priv)
+{
+    SC_T_SIZE x;
+
+    for (x = 0; sm[x].fn != NULL; x++) {
+        if (sm[x].cmd == f->cmd) {
+            sm[x].fn(f->ts, f->mlen, f->msg, f->cctrl, priv);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint32_t SC_T_NAME(sc_frame_ts)(struct SC_T_NAME(sercomm) * sc, struct SC_T_NAME(sercomm_frame) * f)
+{
+    uint32_t ts = 0;
+
+    get_field(&ts, f->ts, sc->ts_bytes);
+    return ts;
+}
+
+/* Try to correct the message by the CRC syndrome. sum2 is the position of the Hash field */
+static int SC_T_NAME(repair_message)(struct SC_T_NAME(sercomm) * sc, uint32_t * cmd, uint32_t sum2)
+{
+    uint32_t len = 0;
+
+    if (sc->crcfix == NULL)
+        return 0;
+    if (sc->crcfix->repair(sc->crcfix, &sc->buffer[sc->buffer_len], &sc->buffer[sum2],
+                &sc->buffer[sc->frame_start_bytes], sum2 - sc->frame_start_bytes) != 0)
+        return 0;
+    //The repaired bit could be in the header: the length should not change
+    get_field(&len, &sc->buffer[sum2 - sc->message_len - sc->len_bytes], sc->len_bytes);
+    if (len != sc->message_len)
+        return 0;
+    get_field(cmd, &sc->buffer[sc->frame_start_bytes], sc->cmd_bytes);
+    return 1;
+}
+
+static void SC_T_NAME(fill_frame)(struct SC_T_NAME(sercomm) * sc, struct SC_T_NAME(sercomm_frame) * f,
+        uint32_t cmd, uint32_t cc)
+{
+    f->ts = &sc->buffer[sc->frame_start_bytes + sc->cmd_bytes];
+    f->cmd = (SC_T_CMD)cmd;
+    f->mlen = sc->message_len;
+    f->msg = &sc->buffer[sc->frame_start_bytes + sc->cmd_bytes + sc->ts_bytes + sc->len_bytes];
+    f->cctrl = (SC_T_CCTRL)cc;
+}
+
+/* Call the speculate callback of the command, if any. The body of the message is received */
+static void SC_T_NAME(speculate)(struct SC_T_NAME(sercomm) * sc)
+{
+    const struct SC_T_NAME(sercomm_spec) * sp;
+    struct SC_T_NAME(sercomm_frame) f;
+    uint32_t cmd = 0;
+
+    get_field(&cmd, &sc->buffer[sc->frame_start_bytes], sc->cmd_bytes);
+    for (sp = sc->spec; sp->speculate != NULL; sp++) {
+        if (sp->cmd == cmd) {
+            SC_T_NAME(fill_frame)(sc, &f, cmd, 0);
+            sc->spec_pending = sp;
+            sp->speculate(&f, sc->priv);
+            return;
+        }
+    }
+}
+
+/* Commit or abort the speculated message, if any */
+static void SC_T_NAME(spec_end)(struct SC_T_NAME(sercomm) * sc, int commit, uint32_t cmd, uint32_t cc)
+{
+    const struct SC_T_NAME(sercomm_spec) * sp = sc->spec_pending;
+    struct SC_T_NAME(sercomm_frame) f;
+
+    if (sp == NULL)
+        return;
+    sc->spec_pending = NULL;
+    SC_T_NAME(fill_frame)(sc, &f, cmd, cc);
+    if (commit) {
+        if (sp->commit != NULL)
+            sp->commit(&f, sc->priv);
+    } else if (sp->abort != NULL) {
+        sp->abort(&f, sc->priv);
+    }
+}
+
+/* Count the dropped message in the statistics, if any. The Command field is in the buffer */
+static void SC_T_NAME(stats_reject)(struct SC_T_NAME(sercomm) * sc)
+{
+    uint32_t cmd = 0;
+
+    if (sc->stats == NULL)
+        return;
+    get_field(&cmd, &sc->buffer[sc->frame_start_bytes], sc->cmd_bytes);
+    sc_stats_reject(sc->stats, cmd);
+}
+
+void SC_T_NAME(sc_get_message)(struct SC_T_NAME(sercomm) * sc, struct SC_T_NAME(sercomm_msg) * sm, 
+        unsigned char byte)
+{
+	uint32_t sum1, sum2, hp = 0, bp = 0;
+    struct SC_T_NAME(sercomm_frame) f;
+    uint32_t cmd = 0, len = 0;
+	uint32_t cc = 0;
+    uint32_t ts = 0;
+    uint32_t t0 = 0;
+    uint8_t skip;
+
+    //Bytes of a filtered message are only counted
+    skip = sc->skip_len > 0;
+    if (skip)
+        sc->skip_len--;
+    else
+        sc->buffer[sc->buffer_len++] = byte;
+
+    if (sc->reset_bytes != SERCOMM_OMIT_RESET) {
+        if (byte == sc->reset_byte)
+            sc->buffer_reset_bytes++;
+        else
+            sc->buffer_reset_bytes = 0;
+        if (sc->reset_bytes == sc->buffer_reset_bytes) {
+            if (sc->reset != NULL)
+                sc->reset();
+            if (sc->spec_pending != NULL) {
+                get_field(&cmd, &sc->buffer[sc->frame_start_bytes], sc->cmd_bytes);
+                SC_T_NAME(spec_end)(sc, 0, cmd, 0);
+            }
+            //A validated header is not cleared before the first byte of the next message
+            if (!skip && sc->header_done && sc->buffer_len > 1)
+                SC_T_NAME(stats_reject)(sc);
+            sc->buffer_len = 0;
+            sc->skip_len = 0;
+            return;
+        }
+    }
+
+    if (skip)
+        return;
+    if (sc->buffer_len == 1)
+        sc->header_done = 0;
+
+    sum1 = 
+        sc->frame_start_bytes + 
+        sc->cmd_bytes + 
+        sc->ts_bytes + 
+        sc->len_bytes;
+    sum2 =
+        sc->frame_start_bytes +
+        sc->cmd_bytes +
+        sc->ts_bytes +
+        sc->len_bytes +
+        sc->message_len +
+        sc->hash_bytes +
+        sc->comm_ctrl_bytes;
+    if (sc->fec != NULL) {
+        hp = SC_FEC_PARITY_LEN(sc->fec->k, sum1 - sc->frame_start_bytes, sc->fec->nsym_hdr);
+        bp = SC_FEC_PARITY_LEN(sc->fec->k, sum2 - sum1, sc->fec->nsym);
+    }
+
+    if (sc->buffer_len == sc->frame_start_bytes) {
+        if (memcmp(sc->buffer, sc->frame_start, sc->frame_start_bytes)) {
+            //If not match, drop it!
+            SC_T_NAME(shift_message)(sc, 1, sc->frame_start_bytes - 1);
+        } 
+    } else if (sc->buffer_len == sum1 + hp && !sc->header_done) {
+        sc->header_done = 1;
+        if (hp > 0) {
+            //Correct the header, and drop its parity
+            if (sc->fec->decode(sc->fec, &sc->buffer[sc->frame_start_bytes], sum1 - sc->frame_start_bytes,
+                        sc->fec->nsym_hdr, &sc->buffer[sum1]) < 0) {
+                //If not correctable, drop it!
+                sc->buffer_len = 0;
+                return;
+            }
+            sc->buffer_len = sum1;
+        }
+        //Validate the length before it is stored in the size type of the variant
+        get_field(&len, &sc->buffer[sum1 - sc->len_bytes], sc->len_bytes);
+        sc->message_len = (SC_T_SIZE)len;
+		if (sc->message_valid_len != SC_T_IGNORE) {
+			if (len != sc->message_valid_len) {
+				//If not match, drop it!
+				SC_T_NAME(stats_reject)(sc);
+				sc->buffer_len = 0;
+			}
+		} else {
+			if (len > sc->message_max_len) {
+				//If not match, drop it!
+				SC_T_NAME(stats_reject)(sc);
+				sc->buffer_len = 0;
+			}
+		}
+        sc->filter_pending = 0;
+        if (sc->buffer_len != 0 && sc->filter != NULL) {
+            get_field(&cmd, &sc->buffer[sc->frame_start_bytes], sc->cmd_bytes);
+            get_field(&ts, &sc->buffer[sc->frame_start_bytes + sc->cmd_bytes], sc->ts_bytes);
+            switch (sc_filter_eval(sc->filter, cmd, ts, sc->message_len, 0, 0)) {
+                case SC_FILTER_FAIL:
+                    //If not match, skip the rest of the message
+                    sc->skip_len = sc->message_len + sc->hash_bytes + sc->comm_ctrl_bytes;
+                    if (sc->fec != NULL)
+                        sc->skip_len += SC_FEC_PARITY_LEN(sc->fec->k, sc->skip_len, sc->fec->nsym);
+                    sc->buffer_len = 0;
+                    break;
+                case SC_FILTER_UNKNOWN:
+                    sc->filter_pending = 1;
+                    break;
+            }
+        }
+    } else if (sc->buffer_len == sum2 + bp && sc->header_done) {
+        if (bp > 0) {
+            //Correct the body, hash and comm. controll part, and drop its parity
+            if (sc->fec->decode(sc->fec, &sc->buffer[sum1], sum2 - sum1,
+                        sc->fec->nsym, &sc->buffer[sum2]) < 0) {
+                //If not correctable, drop it!
+                SC_T_NAME(stats_reject)(sc);
+                sc->buffer_len = 0;
+                return;
+            }
+            sc->buffer_len = sum2;
+        }
+		if (sc->comm_ctrl_bytes > 0)
+            get_field(&cc, &sc->buffer[sc->buffer_len - sc->comm_ctrl_bytes], sc->comm_ctrl_bytes);
+        get_field(&cmd, &sc->buffer[sc->frame_start_bytes], sc->cmd_bytes);
+        if (sc->filter_pending) {
+            sc->filter_pending = 0;
+            get_field(&ts, &sc->buffer[sc->frame_start_bytes + sc->cmd_bytes], sc->ts_bytes);
+            if (sc_filter_eval(sc->filter, cmd, ts, sc->message_len, cc, 1) != SC_FILTER_PASS) {
+                //If not match, drop it without hashing
+                SC_T_NAME(spec_end)(sc, 0, cmd, cc);
+                sc->buffer_len = 0;
+                return;
+            }
+        }
+        if (sc->hash != NULL) {
+            sum2 = 
+                sc->cmd_bytes +
+                sc->ts_bytes +
+                sc->len_bytes +
+                sc->message_len;
+            sc->hash(&sc->buffer[sc->buffer_len], &sc->buffer[sc->frame_start_bytes], sum2);
+            sum2 += sc->frame_start_bytes;
+            if (memcmp(&sc->buffer[sc->buffer_len], &sc->buffer[sum2], sc->hash_bytes) &&
+                    !SC_T_NAME(repair_message)(sc, &cmd, sum2)) {
+                //If not match, drop it!
+                SC_T_NAME(spec_end)(sc, 0, cmd, cc);
+                SC_T_NAME(stats_reject)(sc);
+                sc->buffer_len = 0;
+            } else {
+                SC_T_NAME(spec_end)(sc, 1, cmd, cc);
+                SC_T_NAME(fill_frame)(sc, &f, cmd, cc);
+                if (sc->stats != NULL)
+                    t0 = sc_stats_clock(sc->stats);
+                if (sc->frame != NULL)
+                    sc->frame(sc, sm, &f);
+                else
+                    SC_T_NAME(sc_dispatch)(sm, &f, sc->priv);
+                if (sc->stats != NULL)
+                    sc_stats_rx(sc->stats, cmd, f.mlen, t0);
+                sc->buffer_len = 0;
+            }
+        }
+    }
+
+    //Speculate, when the body is received, but the trailer is not
+    if (sc->spec != NULL && sc->header_done && sc->buffer_len != 0 &&
+            sc->buffer_len == sum1 + sc->message_len && sc->fec == NULL &&
+            sc->hash != NULL && sc->hash_bytes > 0)
+        SC_T_NAME(speculate)(sc);
+}
+
+#undef SC_T_NAME
+#undef SC_T_SIZE
+#undef SC_T_CMD
+#undef SC_T_CCTRL
+#undef SC_T_IGNORE
+
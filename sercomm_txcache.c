@@ -0,0 +1,156 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Encoded frame cache
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <string.h>
+
+#include "sercomm_fec.h"
+#include "sercomm_txcache.h"
+
+void sc_txcache_init(struct sc_txcache * cache, struct sercomm * sc)
+{
+    cache->sc = sc;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->uncached = 0;
+    sc_txcache_clear(cache);
+}
+
+void sc_txcache_clear(struct sc_txcache * cache)
+{
+    uint16_t i;
+
+    for (i = 0; i < cache->nentries; i++) {
+        cache->entries[i].len = 0;
+        cache->entries[i].prev = i > 0 ? i - 1 : SC_TXCACHE_NONE;
+        cache->entries[i].next = i + 1 < cache->nentries ? i + 1 : SC_TXCACHE_NONE;
+    }
+    cache->head = cache->nentries > 0 ? 0 : SC_TXCACHE_NONE;
+    cache->tail = cache->nentries > 0 ? cache->nentries - 1 : SC_TXCACHE_NONE;
+}
+
+/* FNV-1a over the key */
+static uint32_t txcache_key(sc_cmd_t cmd, sc_cctrl_t cctrl, const unsigned char * msg, sc_size_t mlen)
+{
+    uint32_t h = 2166136261u;
+    sc_size_t i;
+
+    h = (h ^ (uint32_t)cmd) * 16777619u;
+    h = (h ^ (uint32_t)cctrl) * 16777619u;
+    h = (h ^ (uint32_t)mlen) * 16777619u;
+    for (i = 0; i < mlen; i++)
+        h = (h ^ msg[i]) * 16777619u;
+    return h;
+}
+
+/* Move the entry to the head of the LRU list */
+static void txcache_touch(struct sc_txcache * cache, uint16_t i)
+{
+    struct sc_txcache_entry * e = &cache->entries[i];
+
+    if (cache->head == i)
+        return;
+    cache->entries[e->prev].next = e->next;
+    if (e->next != SC_TXCACHE_NONE)
+        cache->entries[e->next].prev = e->prev;
+    else
+        cache->tail = e->prev;
+    e->prev = SC_TXCACHE_NONE;
+    e->next = cache->head;
+    cache->entries[cache->head].prev = i;
+    cache->head = i;
+}
+
+const unsigned char * sc_txcache_frame(struct sc_txcache * cache, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        unsigned char * msg, sc_size_t mlen, sc_size_t * len)
+{
+    struct sercomm * sc = cache->sc;
+    struct sc_txcache_entry * e;
+    unsigned char * slot;
+    sc_size_t body_off = sc->frame_start_bytes + sc->cmd_bytes + sc->ts_bytes + sc->len_bytes;
+    sc_size_t n;
+    uint32_t key;
+    uint16_t i;
+
+    if (sc->fec != NULL)
+        body_off += SC_FEC_PARITY_LEN(sc->fec->k, body_off - sc->frame_start_bytes, sc->fec->nsym_hdr);
+    if (cache->nentries == 0 || body_off + mlen + sc->hash_bytes + sc->comm_ctrl_bytes > cache->slot_size) {
+        cache->uncached++;
+        return NULL;
+    }
+
+    key = txcache_key(cmd, cctrl, msg, mlen);
+    for (i = 0; i < cache->nentries; i++) {
+        e = &cache->entries[i];
+        slot = &cache->slots[(uint32_t)i * cache->slot_size];
+        //The body is compared too: a key collision could not send a wrong message
+        if (e->len > 0 && e->key == key && e->cmd == cmd && e->cctrl == cctrl && e->mlen == mlen &&
+                (mlen == 0 || memcmp(&slot[body_off], msg, mlen) == 0)) {
+            txcache_touch(cache, i);
+            cache->hits++;
+            *len = e->len;
+            return slot;
+        }
+    }
+
+    //Replace the least recently used entry
+    i = cache->tail;
+    e = &cache->entries[i];
+    slot = &cache->slots[(uint32_t)i * cache->slot_size];
+    n = sc_make_message(sc, cmd, cctrl, msg, mlen, slot, cache->slot_size);
+    if (n == 0) {
+        //The body parity does not fit: the slot is not written, it keeps its entry at the tail
+        cache->uncached++;
+        return NULL;
+    }
+    if (e->len > 0)
+        cache->evictions++;
+    txcache_touch(cache, i);
+    e->len = n;
+    e->key = key;
+    e->cmd = cmd;
+    e->cctrl = cctrl;
+    e->mlen = mlen;
+    cache->misses++;
+    *len = e->len;
+    return slot;
+}
+
+sc_size_t sc_txcache_make_message(struct sc_txcache * cache, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        unsigned char * msg, sc_size_t mlen,
+        unsigned char * output, sc_size_t olen)
+{
+    const unsigned char * frame;
+    sc_size_t len;
+
+    frame = sc_txcache_frame(cache, cmd, cctrl, msg, mlen, &len);
+    if (frame == NULL)
+        return sc_make_message(cache->sc, cmd, cctrl, msg, mlen, output, olen);
+    if (len > olen)
+        return 0;
+    memcpy(output, frame, len);
+    return len;
+}
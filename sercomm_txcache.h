@@ -0,0 +1,164 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Encoded frame cache
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_TXCACHE_H
+#define _SERCOMM_TXCACHE_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief No entry (end of the LRU list) */
+#define SC_TXCACHE_NONE						UINT16_MAX
+
+/*! \brief Frame cache entry */
+struct sc_txcache_entry {
+	/*! The hash of the key (command, comm. controll value and body) */
+	uint32_t		key;
+	/*! Message command value */
+	sc_cmd_t		cmd;
+	/*! The value of the comm. control field */
+	sc_cctrl_t		cctrl;
+	/*! The length of the message body */
+	sc_size_t		mlen;
+	/*! The length of the encoded message. Zero for an empty entry */
+	sc_size_t		len;
+	/*! The previous (more recently used) entry */
+	uint16_t		prev;
+	/*! The next (less recently used) entry */
+	uint16_t		next;
+};
+
+/*!
+ * \brief Encoded frame cache
+ *
+ * It keeps the encoded form of the repeated outbound messages (i.e., status replies,
+ * acknowledges, polls), so a repeated message is a copy instead of an encoding with a full
+ * hash. The key is the command, the comm. controll value and the body: a cheap hash of them
+ * selects the entry, and the body is compared with the cached message, so a collision could
+ * not send a wrong message. The least recently used entry is replaced on a miss.
+ *
+ * The memory is fixed: nentries entries, and nentries * slot_size bytes of storage. Longer
+ * messages are not cached. The lookup is a linear scan of the entry keys, so keep the cache
+ * small (up to a few tens of entries).
+ *
+ * The Timestamp field is cached too: use it with layouts without Timestamp field, or with a
+ * constant one. Call sc_txcache_clear() after a change of the layout.
+ *
+ * Example:
+ * \code
+ * static struct sc_txcache_entry entries[16];
+ * static unsigned char slots[16 * 32];
+ * static struct sc_txcache cache = {
+ *     .entries = entries, .nentries = 16, .slots = slots, .slot_size = 32,
+ * };
+ *
+ * sc_txcache_init(&cache, &sc);
+ * frame = sc_txcache_frame(&cache, MSG_COMMAND_ACK1, 0, body, len, &n);
+ * write(fd, frame, n);
+ * \endcode
+ */
+struct sc_txcache {
+	/*! The generator of the messages */
+	struct sercomm * sc;
+	/*! Cache entries */
+	struct sc_txcache_entry * entries;
+	/*! The number of the cache entries (less than SC_TXCACHE_NONE) */
+	uint16_t		nentries;
+	/*! The storage of the encoded messages: nentries * slot_size bytes */
+	unsigned char *	slots;
+	/*! The size of one storage slot: the longest cached message with the header */
+	sc_size_t		slot_size;
+	/*! Internal usage: The most recently used entry */
+	uint16_t		head;
+	/*! Internal usage: The least recently used entry */
+	uint16_t		tail;
+	/*! Statistics: The number of the cached messages used */
+	uint32_t		hits;
+	/*! Statistics: The number of the encoded and cached messages */
+	uint32_t		misses;
+	/*! Statistics: The number of the replaced entries */
+	uint32_t		evictions;
+	/*! Statistics: The number of the messages, which are too long to cache */
+	uint32_t		uncached;
+};
+
+/*!
+ * \brief Initialize the frame cache
+ *
+ * \param cache The frame cache
+ * \param sc The generator of the messages
+ */
+void sc_txcache_init(struct sc_txcache * cache, struct sercomm * sc);
+
+/*!
+ * \brief Drop all cached messages
+ *
+ * \param cache The frame cache
+ */
+void sc_txcache_clear(struct sc_txcache * cache);
+
+/*!
+ * \brief Get the encoded message from the cache
+ *
+ * On a miss, the message is encoded into the slot of the least recently used entry.
+ * The returned message could be sent directly (i.e., by writev), but it is valid only until
+ * the next call.
+ *
+ * \param cache The frame cache
+ * \param cmd Message command value
+ * \param cctrl The value of the comm. control field
+ * \param msg Message body
+ * \param mlen The length of the message body
+ * \param len Output: the length of the message with the header
+ *
+ * \return The encoded message, or NULL if it is too long to cache or error occured
+ */
+const unsigned char * sc_txcache_frame(struct sc_txcache * cache, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        unsigned char * msg, sc_size_t mlen, sc_size_t * len);
+
+/*!
+ * \brief Create a message through the cache
+ *
+ * It is the same as sc_make_message(), but a cached message is only copied. Too long
+ * messages are encoded by sc_make_message().
+ *
+ * \param cache The frame cache
+ * \param cmd Message command value
+ * \param cctrl The value of the comm. control field
+ * \param msg Message body
+ * \param mlen The length of the message body
+ * \param output The output buffer
+ * \param olen The size of the output buffer
+ *
+ * \return The length of the message with the header, or zero if error occured
+ */
+sc_size_t sc_txcache_make_message(struct sc_txcache * cache, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        unsigned char * msg, sc_size_t mlen,
+        unsigned char * output, sc_size_t olen);
+
+#endif
+
@@ -0,0 +1,88 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Internal helpers of the modules
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_UTIL_H
+#define _SERCOMM_UTIL_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*
+ * Internal usage only: the modules share these helpers. They are static inline, so a module
+ * does not need another translation unit.
+ */
+
+/* The maximal value of a field of len bytes (i.e., the sequence number mask) */
+static inline uint32_t sc_field_max(uint8_t len)
+{
+    if (len >= 4)
+        return UINT32_MAX;
+    return ((uint32_t)1 << (len * 8)) - 1;
+}
+
+/* The mask of the Timestamp field: the sequence numbers wrap around at its width */
+static inline uint32_t sc_ts_mask(const struct sercomm * sc)
+{
+    return sc_field_max(sc->ts_bytes);
+}
+
+/* Count a value in a log2 histogram: bucket i holds the values below 2^i */
+static inline void sc_hist_add(uint32_t * hist, uint8_t nbuckets, uint32_t v)
+{
+    uint8_t i = 0;
+
+    for (; v != 0 && i < nbuckets - 1; v >>= 1)
+        i++;
+    hist[i]++;
+}
+
+/*
+ * The upper bound of the bucket of the percentile of a log2 histogram, or UINT32_MAX for
+ * the last bucket. below is the number of the values under the first bucket (i.e., the
+ * negative ones).
+ */
+static inline uint32_t sc_hist_percentile(const uint32_t * hist, uint8_t nbuckets,
+        uint32_t below, uint8_t pct)
+{
+    uint32_t total = below, sum = below;
+    uint8_t i;
+
+    for (i = 0; i < nbuckets; i++)
+        total += hist[i];
+    if (total == 0)
+        return 0;
+    total = (uint32_t)(((uint64_t)total * pct + 99) / 100);
+    for (i = 0; i < nbuckets - 1; i++) {
+        sum += hist[i];
+        if (sum >= total)
+            return i == 0 ? 0 : ((uint32_t)1 << i) - 1;
+    }
+    return UINT32_MAX;
+}
+
+#endif
+
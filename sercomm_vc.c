@@ -0,0 +1,218 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Virtual channel multiplexing
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#include <string.h>
+
+#include "sercomm_vc.h"
+#include "sercomm_util.h"
+
+static sc_size_t frame_overhead(struct sercomm * sc)
+{
+    return sc->frame_start_bytes + sc->cmd_bytes + sc->ts_bytes +
+        sc->len_bytes + sc->hash_bytes + sc->comm_ctrl_bytes;
+}
+
+static sc_cctrl_t vc_bits(struct sc_vcmux * mux)
+{
+    return (mux->vc_mask << mux->vc_shift) | mux->ack_flag;
+}
+
+void sc_vc_init(struct sc_vcmux * mux, struct sercomm * sc)
+{
+    struct sc_vc * v;
+    uint8_t i;
+
+    mux->sc = sc;
+    mux->rr = 0;
+    mux->rr_served = 0;
+    for (i = 0; i < mux->nvc; i++) {
+        v = &mux->vc[i];
+        v->head = 0;
+        v->count = 0;
+        v->sent = 0;
+        v->ack_pending = 0;
+        v->tx_seq = 0;
+        v->rx_seq = 0;
+        v->sent_time = 0;
+        v->deficit = 0;
+    }
+    sc->frame = sc_vc_frame;
+    sc->priv = mux;
+}
+
+int sc_vc_send(struct sc_vcmux * mux, uint8_t vc, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        const unsigned char * msg, sc_size_t mlen)
+{
+    struct sc_vc * v;
+    struct sc_vc_slot * s;
+    uint8_t idx;
+
+    if (vc >= mux->nvc)
+        return -1;
+    v = &mux->vc[vc];
+    if (v->count >= v->nslots || mlen > v->slot_size)
+        return -1;
+
+    idx = (v->head + v->count) % v->nslots;
+    s = &v->slots[idx];
+    s->cmd = cmd;
+    s->cctrl = cctrl & ~vc_bits(mux);
+    s->mlen = mlen;
+    s->body = &v->bodies[(sc_size_t)idx * v->slot_size];
+    if (mlen > 0)
+        memcpy(s->body, msg, mlen);
+    v->count++;
+    return 0;
+}
+
+static int vc_eligible(struct sc_vc * v)
+{
+    if (v->count <= v->sent)
+        return 0;
+    if (v->reliable && v->sent >= v->window)
+        return 0;
+    return 1;
+}
+
+sc_size_t sc_vc_next(struct sc_vcmux * mux, uint32_t now,
+        unsigned char * output, sc_size_t olen)
+{
+    struct sercomm * sc = mux->sc;
+    struct sc_vc * v;
+    struct sc_vc_slot * s;
+    sc_size_t n, size, quantum;
+    uint8_t i;
+
+    mux->now = now;
+
+    //Acknowledges first: they are short, and they keep the peers going
+    for (i = 0; i < mux->nvc; i++) {
+        v = &mux->vc[i];
+        if (!v->ack_pending)
+            continue;
+        n = sc_make_message_ts(sc, mux->ack_cmd, ((sc_cctrl_t)i << mux->vc_shift) | mux->ack_flag,
+                v->rx_seq, NULL, 0, output, olen);
+        if (n > 0)
+            v->ack_pending = 0;
+        return n;
+    }
+
+    //Go back N on timeout
+    for (i = 0; i < mux->nvc; i++) {
+        v = &mux->vc[i];
+        if (v->reliable && v->sent > 0 && now - v->sent_time >= mux->rto) {
+            v->sent = 0;
+            v->tx_timeouts++;
+        }
+    }
+
+    for (i = 0; i < mux->nvc; i++) {
+        if (vc_eligible(&mux->vc[i]))
+            break;
+    }
+    if (i == mux->nvc)
+        return 0;
+
+    //Deficit round robin
+    for (;;) {
+        v = &mux->vc[mux->rr];
+        if (!vc_eligible(v)) {
+            v->deficit = 0;
+            mux->rr = (mux->rr + 1) % mux->nvc;
+            mux->rr_served = 0;
+            continue;
+        }
+        s = &v->slots[(v->head + v->sent) % v->nslots];
+        size = frame_overhead(sc) + s->mlen;
+        if (!mux->rr_served) {
+            quantum = v->quantum > 0 ? v->quantum : frame_overhead(sc) + v->slot_size;
+            v->deficit += quantum;
+            mux->rr_served = 1;
+        }
+        if (v->deficit >= size)
+            break;
+        mux->rr = (mux->rr + 1) % mux->nvc;
+        mux->rr_served = 0;
+    }
+
+    n = sc_make_message_ts(sc, s->cmd, s->cctrl | ((sc_cctrl_t)mux->rr << mux->vc_shift),
+            (v->tx_seq + v->sent) & sc_ts_mask(sc), s->body, s->mlen, output, olen);
+    if (n == 0)
+        return 0;
+    v->deficit -= size;
+    v->tx_messages++;
+    if (v->reliable) {
+        if (v->sent == 0)
+            v->sent_time = now;
+        v->sent++;
+    } else {
+        v->head = (v->head + 1) % v->nslots;
+        v->count--;
+        v->tx_seq = (v->tx_seq + 1) & sc_ts_mask(sc);
+    }
+    return n;
+}
+
+void sc_vc_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_vcmux * mux = sc->priv;
+    struct sc_vc * v;
+    uint32_t seq, mask = sc_ts_mask(sc), acked;
+    sc_cctrl_t n;
+
+    (void)sm;
+    n = (f->cctrl >> mux->vc_shift) & mux->vc_mask;
+    if (n >= mux->nvc)
+        return;
+    v = &mux->vc[n];
+    seq = sc_frame_ts(sc, f) & mask;
+
+    if ((f->cctrl & mux->ack_flag) && f->cmd == mux->ack_cmd) {
+        acked = (seq - v->tx_seq) & mask;
+        if (acked == 0 || acked > v->sent)
+            return;
+        v->head = (v->head + acked) % v->nslots;
+        v->count -= acked;
+        v->sent -= acked;
+        v->tx_seq = seq;
+        //Restart the timer for the rest
+        v->sent_time = mux->now;
+        return;
+    }
+
+    if (v->reliable) {
+        v->ack_pending = 1;
+        if (seq != v->rx_seq) {
+            //Duplicated or out of order: go back N drops it
+            v->rx_dropped++;
+            return;
+        }
+    }
+    v->rx_seq = (seq + 1) & mask;
+    v->rx_messages++;
+    f->cctrl &= ~vc_bits(mux);
+    sc_dispatch(v->sm, f, v->priv);
+}
+
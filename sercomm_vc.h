@@ -0,0 +1,207 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Virtual channel multiplexing
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+#ifndef _SERCOMM_VC_H
+#define _SERCOMM_VC_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*! \brief Queued message of a virtual channel */
+struct sc_vc_slot {
+	/*! Message command value */
+	sc_cmd_t		cmd;
+	/*! The value of the comm. control field (without the channel bits) */
+	sc_cctrl_t		cctrl;
+	/*! The length of the message body */
+	sc_size_t		mlen;
+	/*! Message body. It points into the body storage of the channel */
+	unsigned char * body;
+};
+
+/*!
+ * \brief Virtual channel
+ *
+ * Each virtual channel has its own command table, sequence numbers and transmit queue.
+ * The channel storage is given by the caller:
+ * \code
+ * static struct sc_vc_slot ctrl_slots[4];
+ * static unsigned char ctrl_bodies[4 * 32];
+ * static struct sc_vc vcs[] = {
+ *     { .sm = ctrl_sms, .reliable = 1, .window = 2, .quantum = 64,
+ *       .slots = ctrl_slots, .nslots = 4, .bodies = ctrl_bodies, .slot_size = 32 },
+ *     { .sm = bulk_sms, .reliable = 1, .window = 8, .quantum = 256,
+ *       .slots = bulk_slots, .nslots = 16, .bodies = bulk_bodies, .slot_size = 256 },
+ * };
+ * \endcode
+ */
+struct sc_vc {
+	/*! The struct sercomm_msg array of the channel */
+	struct sercomm_msg * sm;
+	/*! Last priv argument of the command callbacks of the channel */
+	void *			priv;
+	/*! Non-zero for acknowledged, in-order delivery (go-back-N). Zero for best effort */
+	uint8_t			reliable;
+	/*! The maximum number of unacknowledged messages (reliable channels) */
+	uint8_t			window;
+	/*! Fair scheduling: the number of bytes the channel could send in one round */
+	sc_size_t		quantum;
+	/*! Transmit queue slots */
+	struct sc_vc_slot * slots;
+	/*! The number of slots */
+	uint8_t			nslots;
+	/*! Body storage: nslots * slot_size bytes */
+	unsigned char * bodies;
+	/*! The maximum body length of a queued message */
+	sc_size_t		slot_size;
+	/*! Internal usage: The index of the oldest queued message */
+	uint8_t			head;
+	/*! Internal usage: The number of queued messages */
+	uint8_t			count;
+	/*! Internal usage: The number of sent, but not acknowledged messages (from head) */
+	uint8_t			sent;
+	/*! Internal usage: An acknowledge should be sent */
+	uint8_t			ack_pending;
+	/*! Internal usage: The sequence number of the head message */
+	uint32_t		tx_seq;
+	/*! Internal usage: The next expected sequence number */
+	uint32_t		rx_seq;
+	/*! Internal usage: The sending time of the oldest unacknowledged message */
+	uint32_t		sent_time;
+	/*! Internal usage: Fair scheduling deficit counter */
+	sc_size_t		deficit;
+	/*! Statistics: The number of delivered messages */
+	uint32_t		rx_messages;
+	/*! Statistics: The number of dropped out of order or duplicated messages */
+	uint32_t		rx_dropped;
+	/*! Statistics: The number of sent messages (with the retransmissions) */
+	uint32_t		tx_messages;
+	/*! Statistics: The number of retransmission timeouts */
+	uint32_t		tx_timeouts;
+};
+
+/*!
+ * \brief Virtual channel multiplexer
+ *
+ * It carries several logical conversations over one physical link, behind one parser.
+ * The channel number is carried in the Comm. controll field (vc_mask << vc_shift bits),
+ * and the sequence number is carried in the Timestamp field, so the layout should have
+ * both of them. The other bits of the Comm. controll field are passed to the command callbacks.
+ *
+ * Acknowledges are empty messages with the ack_cmd command, the ack_flag bit in the Comm.
+ * controll field and the next expected sequence number in the Timestamp field.
+ *
+ * The transmit side is pulled by sc_vc_next(): acknowledges go first, then the channels
+ * get their turn by deficit round robin, so a bulk channel could not starve the others.
+ *
+ * Example:
+ * \code
+ * static struct sc_vcmux mux = {
+ *     .vc = vcs, .nvc = 2, .vc_shift = 4, .vc_mask = 0x7, .ack_flag = 0x80,
+ *     .ack_cmd = 0xFF, .rto = 100,
+ * };
+ *
+ * sc_vc_init(&mux, &sc);
+ * sc_vc_send(&mux, 0, MSG_COMMAND_ALARM, 0, body, len);
+ * while ((n = sc_vc_next(&mux, now_ms(), frame, sizeof(frame))) > 0)
+ *     uart_send_message(frame, n);
+ * \endcode
+ */
+struct sc_vcmux {
+	/*! The parser and generator of the link */
+	struct sercomm * sc;
+	/*! The array of the virtual channels */
+	struct sc_vc *	vc;
+	/*! The number of the virtual channels */
+	uint8_t			nvc;
+	/*! The position of the channel number in the Comm. controll field */
+	uint8_t			vc_shift;
+	/*! The mask of the channel number (not shifted) */
+	sc_cctrl_t		vc_mask;
+	/*! The acknowledge bit in the Comm. controll field */
+	sc_cctrl_t		ack_flag;
+	/*! The command of the acknowledges */
+	sc_cmd_t		ack_cmd;
+	/*! Retransmission timeout, in the time unit of sc_vc_next() */
+	uint32_t		rto;
+	/*! Internal usage: The channel in turn */
+	uint8_t			rr;
+	/*! Internal usage: The channel in turn already got its quantum */
+	uint8_t			rr_served;
+	/*! Internal usage: The last time given to sc_vc_next() */
+	uint32_t		now;
+};
+
+/*!
+ * \brief Initialize the multiplexer
+ *
+ * It resets the channel states, and sets the frame callback and the priv field of struct sercomm.
+ *
+ * \param mux The multiplexer
+ * \param sc The parser and generator of the link
+ */
+void sc_vc_init(struct sc_vcmux * mux, struct sercomm * sc);
+
+/*!
+ * \brief Queue a message on a virtual channel
+ *
+ * \param mux The multiplexer
+ * \param vc The channel number
+ * \param cmd Message command value
+ * \param cctrl The value of the comm. control field (without the channel bits)
+ * \param msg Message body
+ * \param mlen The length of the message body
+ *
+ * \return Zero on success, or -1 if the queue is full or the message is too long
+ */
+int sc_vc_send(struct sc_vcmux * mux, uint8_t vc, sc_cmd_t cmd, sc_cctrl_t cctrl,
+        const unsigned char * msg, sc_size_t mlen);
+
+/*!
+ * \brief Get the next message to send on the link
+ *
+ * Call it repeatedly until it returns zero, whenever the link could accept data,
+ * and periodically for the retransmissions.
+ *
+ * \param mux The multiplexer
+ * \param now The current time (any monotonic unit, the same as rto)
+ * \param output The output buffer
+ * \param olen The size of the output buffer
+ *
+ * \return The length of the message, or zero if there is nothing to send
+ */
+sc_size_t sc_vc_next(struct sc_vcmux * mux, uint32_t now,
+        unsigned char * output, sc_size_t olen);
+
+/*!
+ * \brief Frame callback of the multiplexer
+ *
+ * sc_vc_init() sets it in struct sercomm.
+ */
+void sc_vc_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+
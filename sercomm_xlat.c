@@ -0,0 +1,119 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Layout translation
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#include <string.h>
+
+#include "sercomm_xlat.h"
+#include "sercomm_util.h"
+
+static int field_width_ok(uint8_t len)
+{
+    return len == 0 || len == 1 || len == 2 || len == 4;
+}
+
+/* Host byte order, like the fields of sc_make_message() */
+static void xlat_put(unsigned char * dst, uint32_t v, uint8_t len)
+{
+    uint16_t v16;
+
+    switch (len) {
+        case 1:
+            *dst = (unsigned char)v;
+            break;
+        case 2:
+            v16 = (uint16_t)v;
+            memcpy(dst, &v16, sizeof(v16));
+            break;
+        case 4:
+            memcpy(dst, &v, sizeof(v));
+            break;
+    }
+}
+
+int sc_xlat_init(struct sc_xlat * x, struct sercomm * src, struct sercomm * dst)
+{
+    if (dst->fec != NULL || !field_width_ok(dst->cmd_bytes) || !field_width_ok(dst->ts_bytes) ||
+            !field_width_ok(dst->len_bytes) || !field_width_ok(dst->comm_ctrl_bytes) ||
+            (dst->hash_bytes > 0 && dst->hash == NULL))
+        return -1;
+
+    x->src = src;
+    x->dst = dst;
+    x->cmd_off = dst->frame_start_bytes;
+    x->ts_off = x->cmd_off + dst->cmd_bytes;
+    x->len_off = x->ts_off + dst->ts_bytes;
+    x->body_off = x->len_off + dst->len_bytes;
+    x->ts_copy = src->ts_bytes < dst->ts_bytes ? src->ts_bytes : dst->ts_bytes;
+    x->cmd_max = sc_field_max(dst->cmd_bytes);
+    x->len_max = sc_field_max(dst->len_bytes);
+    x->cctrl_max = sc_field_max(dst->comm_ctrl_bytes);
+    src->frame = sc_xlat_frame;
+    src->priv = x;
+    return 0;
+}
+
+void sc_xlat_feed(struct sc_xlat * x, const unsigned char * data, sc_size_t len)
+{
+    sc_size_t i;
+
+    for (i = 0; i < len; i++)
+        sc_get_message(x->src, NULL, data[i]);
+}
+
+void sc_xlat_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f)
+{
+    struct sc_xlat * x = sc->priv;
+    struct sercomm * dst = x->dst;
+    unsigned char * out = x->out;
+    uint32_t ts, n;
+
+    (void)sm;
+    //In uint32_t: the sum could overflow a tiny sc_size_t
+    n = (uint32_t)x->body_off + f->mlen + dst->hash_bytes + dst->comm_ctrl_bytes;
+    if ((uint32_t)f->cmd > x->cmd_max || (uint32_t)f->mlen > x->len_max ||
+            (uint32_t)f->cctrl > x->cctrl_max || n > x->out_size) {
+        x->dropped++;
+        return;
+    }
+
+    if (dst->frame_start_bytes > 0)
+        memcpy(out, dst->frame_start, dst->frame_start_bytes);
+    xlat_put(&out[x->cmd_off], f->cmd, dst->cmd_bytes);
+    //Zero extend, or keep the lower bytes
+    ts = x->ts_copy > 0 ? sc_frame_ts(sc, f) & sc_field_max(x->ts_copy) : 0;
+    xlat_put(&out[x->ts_off], ts, dst->ts_bytes);
+    xlat_put(&out[x->len_off], f->mlen, dst->len_bytes);
+    if (f->mlen > 0)
+        memcpy(&out[x->body_off], f->msg, f->mlen);
+    if (dst->hash_bytes > 0)
+        dst->hash(&out[x->body_off + f->mlen], &out[dst->frame_start_bytes],
+                x->body_off - dst->frame_start_bytes + f->mlen);
+    if (dst->comm_ctrl_bytes > 0)
+        xlat_put(&out[x->body_off + f->mlen + dst->hash_bytes], f->cctrl, dst->comm_ctrl_bytes);
+
+    x->translated++;
+    x->write(x, out, (sc_size_t)n);
+}
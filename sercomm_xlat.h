@@ -0,0 +1,125 @@
+/*
+ * Serial message generator and parser for embedded systems
+ * Layout translation
+ *
+ * Author: Andras Takacs <andras.takacs@emsol.hu>
+ *
+ * Version 0.4
+ *
+ * Copyright (c) 2009-2012 Emsol Mernok Iroda
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms are permitted
+ * provided that the above copyright notice and this paragraph are
+ * duplicated in all such forms and that any documentation,
+ * advertising materials, and other materials related to such
+ * distribution and use acknowledge that the software was developed
+ * by the Emsol Mernok Iroda.  The name of the
+ * University may not be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND WITHOUT ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, WITHOUT LIMITATION, THE IMPLIED
+ * WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ */
+
+
+#ifndef _SERCOMM_XLAT_H
+#define _SERCOMM_XLAT_H
+
+#include <inttypes.h>
+
+#include "sercomm.h"
+
+/*!
+ * \brief Layout translation
+ *
+ * It translates the messages of one layout (the source dialect) to another layout (the
+ * destination dialect), i.e., from a legacy device with 1 byte long Command and Message length
+ * fields and CRC-16 to a new one with 4 bytes long fields and CRC-32. The messages are not
+ * dispatched: the validated message of the source parser is written to the output buffer at
+ * once with the destination frame start, the widened or narrowed header fields, the body, the
+ * new hash and the comm. controll field. The field offsets and limits are computed by
+ * sc_xlat_init(), so a message costs one copy of the body and one hash.
+ *
+ * The Timestamp field is zero extended, or its lower bytes are kept. A message, whose Command,
+ * Message length or comm. controll value does not fit the destination field, is dropped.
+ * The destination struct sercomm gives only the layout and the hash: its buffer is not used,
+ * and FEC is not supported on the destination side.
+ *
+ * Example:
+ * \code
+ * static unsigned char xbuf[4 + 4 + 4 + 4 + 1024 + 4 + 1];
+ * static struct sc_xlat x = { .out = xbuf, .out_size = sizeof(xbuf), .write = new_port_write };
+ *
+ * sc_xlat_init(&x, &sc_legacy, &sc_new);
+ * n = read(legacy_fd, buf, sizeof(buf));
+ * sc_xlat_feed(&x, buf, n);
+ * \endcode
+ */
+struct sc_xlat {
+	/*! The parser of the source layout */
+	struct sercomm * src;
+	/*! The destination layout and hash */
+	struct sercomm * dst;
+	/*! The output buffer. Its size limits the translated messages */
+	unsigned char *	out;
+	/*! The size of the output buffer */
+	sc_size_t		out_size;
+	/*! Write callback of the translated messages */
+	void			(* write)(struct sc_xlat * x, const unsigned char * data, sc_size_t len);
+	/*! Last argument of the write callback, free for the caller */
+	void *			priv;
+	/*! Internal usage: The offset of the destination Command field */
+	sc_size_t		cmd_off;
+	/*! Internal usage: The offset of the destination Timestamp field */
+	sc_size_t		ts_off;
+	/*! Internal usage: The offset of the destination Message length field */
+	sc_size_t		len_off;
+	/*! Internal usage: The offset of the destination body */
+	sc_size_t		body_off;
+	/*! Internal usage: The number of the copied Timestamp bytes */
+	uint8_t			ts_copy;
+	/*! Internal usage: The maximal destination Command value */
+	uint32_t		cmd_max;
+	/*! Internal usage: The maximal destination body length */
+	uint32_t		len_max;
+	/*! Internal usage: The maximal destination comm. controll value */
+	uint32_t		cctrl_max;
+	/*! Statistics: The number of translated messages */
+	uint32_t		translated;
+	/*! Statistics: The number of dropped messages (a field does not fit, or the output buffer is too small) */
+	uint32_t		dropped;
+};
+
+/*!
+ * \brief Initialize the layout translation
+ *
+ * It computes the field mapping, and sets the frame callback and the priv field of src.
+ *
+ * \param x The layout translation
+ * \param src The parser of the source layout
+ * \param dst The destination layout
+ *
+ * \return Zero on success, or -1 if the destination layout is not supported
+ */
+int sc_xlat_init(struct sc_xlat * x, struct sercomm * src, struct sercomm * dst);
+
+/*!
+ * \brief Parse and translate the received bytes
+ *
+ * \param x The layout translation
+ * \param data The received bytes of the source layout
+ * \param len The number of the received bytes
+ */
+void sc_xlat_feed(struct sc_xlat * x, const unsigned char * data, sc_size_t len);
+
+/*!
+ * \brief Frame callback of the layout translation
+ *
+ * sc_xlat_init() sets it in the source parser.
+ */
+void sc_xlat_frame(struct sercomm * sc, struct sercomm_msg * sm, struct sercomm_frame * f);
+
+#endif
+